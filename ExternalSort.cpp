@@ -0,0 +1,351 @@
+#include "ExternalSort.h"
+#include "Sort.h"
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <stdexcept>
+#include <unistd.h>
+using namespace std;
+
+/**
+ * The key of a record held in memory.
+ * Keys compare as unsigned bytes, like memcmp.
+ */
+struct RecordKey
+{
+    const char *key;
+    int length;
+
+    bool operator< ( const RecordKey & rhs ) const
+      { return memcmp( key, rhs.key, length ) < 0; }
+};
+
+/**
+ * Reads the records of a file sequentially,
+ * through a buffer of bufferBytes.
+ */
+class RecordReader
+{
+  public:
+    RecordReader( const string & fileName, int recordBytes, long long bufferBytes )
+      : in{ fileName, ios::binary }, recordSize{ recordBytes },
+        buffer( max( 1LL, bufferBytes / recordBytes ) * recordBytes ),
+        pos{ 0 }, end{ 0 }
+    {
+        if( !in )
+            throw runtime_error{ "Cannot open " + fileName };
+        refill( );
+    }
+
+    bool isDone( ) const
+      { return pos == end; }
+
+    const char * current( ) const
+      { return &buffer[ pos ]; }
+
+    void advance( )
+    {
+        pos += recordSize;
+        if( pos == end )
+            refill( );
+    }
+
+  private:
+    ifstream in;
+    int recordSize;
+    vector<char> buffer;
+    size_t pos;
+    size_t end;
+
+    void refill( )
+    {
+        in.read( &buffer[ 0 ], buffer.size( ) );
+        pos = 0;
+        end = in.gcount( ) - in.gcount( ) % recordSize;
+        if( in.bad( ) )
+            throw runtime_error{ "Read error" };
+    }
+};
+
+/**
+ * Writes records to a file sequentially,
+ * through a buffer of bufferBytes.
+ */
+class RecordWriter
+{
+  public:
+    RecordWriter( const string & fileName, int recordBytes, long long bufferBytes )
+      : out{ fileName, ios::binary | ios::trunc }, recordSize{ recordBytes },
+        buffer( max( 1LL, bufferBytes / recordBytes ) * recordBytes ), pos{ 0 }
+    {
+        if( !out )
+            throw runtime_error{ "Cannot create " + fileName };
+    }
+
+    ~RecordWriter( )
+    {
+        try
+          { flush( ); }
+        catch( ... )
+          { }
+    }
+
+    void write( const char *record )
+    {
+        if( pos == buffer.size( ) )
+            flush( );
+        memcpy( &buffer[ pos ], record, recordSize );
+        pos += recordSize;
+    }
+
+    void flush( )
+    {
+        out.write( &buffer[ 0 ], pos );
+        pos = 0;
+        if( !out )
+            throw runtime_error{ "Write error" };
+    }
+
+  private:
+    ofstream out;
+    int recordSize;
+    vector<char> buffer;
+    size_t pos;
+};
+
+/**
+ * Loser tree for a k-way merge (Knuth, Vol. 3, 5.4.1).
+ * Each internal node holds the input that lost the match played there,
+ * and node 0 holds the overall winner, so replacing the winner's record
+ * costs one match per level: log k comparisons, with no swaps.
+ * An input that is done loses to everything; ties go to the lower
+ * numbered input.
+ */
+class LoserTree
+{
+  public:
+    LoserTree( vector<RecordReader *> & inputs, int keyOffset, int keyLength )
+      : sources( inputs ), k( inputs.size( ) ), tree( inputs.size( ), inputs.size( ) ),
+        offset{ keyOffset }, length{ keyLength }
+    {
+            // Index k stands for a key smaller than any other,
+            // so the first matches of each input just fill the tree
+        for( int i = k - 1; i >= 0; --i )
+            replay( i );
+    }
+
+    /**
+     * Return the input holding the smallest record,
+     * or -1 if every input is done.
+     */
+    int winner( ) const
+      { return sources[ tree[ 0 ] ]->isDone( ) ? -1 : tree[ 0 ]; }
+
+    /**
+     * Advance the winning input and play its new record up the tree.
+     */
+    void advanceWinner( )
+    {
+        sources[ tree[ 0 ] ]->advance( );
+        replay( tree[ 0 ] );
+    }
+
+  private:
+    vector<RecordReader *> & sources;
+    int k;
+    vector<int> tree;
+    int offset;
+    int length;
+
+    bool beats( int a, int b ) const
+    {
+        if( a == k || b == k )
+            return a == k;
+        if( sources[ b ]->isDone( ) )
+            return !sources[ a ]->isDone( ) || a < b;
+        if( sources[ a ]->isDone( ) )
+            return false;
+
+        int cmp = memcmp( sources[ a ]->current( ) + offset,
+                          sources[ b ]->current( ) + offset, length );
+        return cmp < 0 || ( cmp == 0 && a < b );
+    }
+
+    void replay( int input )
+    {
+        int winner = input;
+
+        for( int node = ( input + k ) / 2; node > 0; node /= 2 )
+            if( beats( tree[ node ], winner ) )
+                std::swap( tree[ node ], winner );
+        tree[ 0 ] = winner;
+    }
+};
+
+/**
+ * Return a new temporary file name in directory.
+ */
+static string tempFileName( const string & directory )
+{
+    static int counter = 0;
+    return directory + "/extsort-" + to_string( getpid( ) ) + "-"
+                     + to_string( counter++ ) + ".run";
+}
+
+static double secondsSince( chrono::steady_clock::time_point start )
+{
+    return chrono::duration<double>( chrono::steady_clock::now( ) - start ).count( );
+}
+
+/**
+ * Merge the sorted files in runs into outputFile.
+ */
+static void mergeFiles( const vector<string> & runs, const string & outputFile,
+                        const ExternalSortOptions & options )
+{
+    long long bufferBytes = options.memoryBytes / ( runs.size( ) + 1 );
+    vector<RecordReader *> readers;
+
+    try
+    {
+        for( const string & run : runs )
+            readers.push_back( new RecordReader{ run, options.recordSize, bufferBytes } );
+
+        RecordWriter out{ outputFile, options.recordSize, bufferBytes };
+        LoserTree tree{ readers, options.keyOffset, options.keyLength };
+
+        for( int w; ( w = tree.winner( ) ) >= 0; tree.advanceWinner( ) )
+            out.write( readers[ w ]->current( ) );
+        out.flush( );
+    }
+    catch( ... )
+    {
+        for( RecordReader *r : readers )
+            delete r;
+        throw;
+    }
+
+    for( RecordReader *r : readers )
+        delete r;
+}
+
+/**
+ * Read inputFile in chunks that fit in memory, sort each chunk, and
+ * write it as a run. A single run is written straight to outputFile.
+ * The names of the run files (none if there was one run) are added to
+ * runs as the files are created.
+ */
+static void makeRuns( const string & inputFile, const string & outputFile,
+                      const ExternalSortOptions & options, long long totalRecords,
+                      vector<string> & runs, ExternalSortStats & stats )
+{
+    const long long WRITE_BUFFER = min( 8LL << 20, options.memoryBytes / 8 );
+    int recordSize = options.recordSize;
+    long long chunkRecords = ( options.memoryBytes - WRITE_BUFFER )
+                                 / ( recordSize + long( sizeof( RecordKey ) ) );
+    if( chunkRecords < 1 )
+        throw invalid_argument{ "Not enough memory for one record" };
+    chunkRecords = min( chunkRecords, max( totalRecords, 1LL ) );
+
+    ifstream in{ inputFile, ios::binary };
+    vector<char> chunk( chunkRecords * recordSize );
+    vector<RecordKey> keys;
+
+    for( long long done = 0; done < totalRecords || stats.runs == 0; )
+    {
+        long long count = min( chunkRecords, totalRecords - done );
+        in.read( &chunk[ 0 ], count * recordSize );
+        if( in.gcount( ) != count * recordSize )
+            throw runtime_error{ "Short read from " + inputFile };
+
+        keys.resize( count );
+        for( long long i = 0; i < count; ++i )
+            keys[ i ] = RecordKey{ &chunk[ i * recordSize + options.keyOffset ],
+                                   options.keyLength };
+        parallelQuicksort( keys, options.numThreads );
+
+        done += count;
+        ++stats.runs;
+        bool onlyRun = done == totalRecords && runs.empty( );
+        string runFile = onlyRun ? outputFile : tempFileName( options.tempDirectory );
+        if( !onlyRun )
+            runs.push_back( runFile );
+
+        RecordWriter out{ runFile, recordSize, WRITE_BUFFER };
+        for( const RecordKey & key : keys )
+            out.write( key.key - options.keyOffset );
+        out.flush( );
+    }
+}
+
+/**
+ * Sort the fixed-width records of inputFile into outputFile.
+ * Returns counts and timings.
+ */
+ExternalSortStats externalSort( const string & inputFile, const string & outputFile,
+                                const ExternalSortOptions & options )
+{
+    if( options.recordSize <= 0 || options.keyOffset < 0 || options.keyLength <= 0
+        || options.keyOffset + options.keyLength > options.recordSize )
+        throw invalid_argument{ "Bad record or key size" };
+    if( options.maxFanIn < 2 )
+        throw invalid_argument{ "maxFanIn must be at least 2" };
+
+    ifstream probe{ inputFile, ios::binary | ios::ate };
+    if( !probe )
+        throw runtime_error{ "Cannot open " + inputFile };
+    long long bytes = probe.tellg( );
+    if( bytes % options.recordSize != 0 )
+        throw invalid_argument{ "File size is not a multiple of the record size" };
+    probe.close( );
+
+    ExternalSortStats stats{ bytes / options.recordSize, bytes, 0, 0, 0.0, 0.0 };
+    vector<string> runs;
+    vector<string> merged;
+
+    try
+    {
+        auto start = chrono::steady_clock::now( );
+        makeRuns( inputFile, outputFile, options, stats.records, runs, stats );
+        stats.runSeconds = secondsSince( start );
+
+        start = chrono::steady_clock::now( );
+        while( runs.size( ) > options.maxFanIn )      // Intermediate passes
+        {
+            for( int i = 0; i < runs.size( ); i += options.maxFanIn )
+            {
+                vector<string> group( begin( runs ) + i,
+                                      begin( runs ) + min<int>( i + options.maxFanIn, runs.size( ) ) );
+                merged.push_back( tempFileName( options.tempDirectory ) );
+                mergeFiles( group, merged.back( ), options );
+                for( const string & run : group )
+                    remove( run.c_str( ) );
+            }
+            runs.swap( merged );
+            merged.clear( );
+            ++stats.mergePasses;
+        }
+
+        if( !runs.empty( ) )
+        {
+            mergeFiles( runs, outputFile, options );
+            ++stats.mergePasses;
+        }
+        stats.mergeSeconds = secondsSince( start );
+    }
+    catch( ... )
+    {
+        for( const string & run : runs )
+            remove( run.c_str( ) );
+        for( const string & run : merged )
+            remove( run.c_str( ) );
+        throw;
+    }
+
+    for( const string & run : runs )
+        remove( run.c_str( ) );
+
+    return stats;
+}
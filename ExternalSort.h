@@ -0,0 +1,58 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+// External merge sort for files of fixed-width records
+//
+// CONSTRUCTION: ExternalSortOptions with the record size; the other
+//     fields have defaults and may be changed before sorting.
+//
+// ******************PUBLIC OPERATIONS*********************
+// ExternalSortStats externalSort( in, out, options )
+//                     --> Sort file in into file out
+// ******************ERRORS********************************
+// Throws invalid_argument for bad options or an input file whose size
+// is not a multiple of the record size, and runtime_error for I/O errors.
+//
+// Records are ordered by memcmp of their key bytes. The sort reads the
+// input in chunks that fit in memoryBytes, sorts each chunk in parallel
+// (parallelQuicksort from Sort.h on pointers to the records), and writes
+// it out as a sorted run. The runs are then combined by k-way merges
+// driven by a loser tree, through large sequential buffers; if there are
+// more runs than maxFanIn, intermediate merge passes are made first.
+
+#include <string>
+#include <thread>
+using namespace std;
+
+struct ExternalSortOptions
+{
+    explicit ExternalSortOptions( int recordBytes )
+      : recordSize{ recordBytes }, keyOffset{ 0 }, keyLength{ recordBytes },
+        memoryBytes{ 256 << 20 }, numThreads{ int( thread::hardware_concurrency( ) ) },
+        maxFanIn{ 64 }, tempDirectory{ "." }
+    {
+    }
+
+    int recordSize;          // Bytes per record
+    int keyOffset;           // Key is record[ keyOffset..keyOffset+keyLength-1 ]
+    int keyLength;
+    long long memoryBytes;   // Memory for sorting a chunk or merge buffers
+    int numThreads;          // Threads for sorting each chunk
+    int maxFanIn;            // Most runs combined by one merge
+    string tempDirectory;    // Where the runs are written
+};
+
+struct ExternalSortStats
+{
+    long long records;
+    long long bytes;
+    int runs;                // Sorted runs made from the input
+    int mergePasses;         // 0 if the input fit in one run
+    double runSeconds;       // Reading, sorting, and writing runs
+    double mergeSeconds;     // Merging runs into the output
+};
+
+ExternalSortStats externalSort( const string & inputFile, const string & outputFile,
+                                const ExternalSortOptions & options );
+
+#endif
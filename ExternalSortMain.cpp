@@ -0,0 +1,99 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#include <stdexcept>
+#include "ExternalSort.h"
+using namespace std;
+
+/*
+ * Command-line front end for externalSort.
+ * Usage: externalSort [options] input output
+ *   -r bytes       record size (required)
+ *   -k off:len     key position within the record (default: whole record)
+ *   -m megabytes   memory for sorting and merging (default 256)
+ *   -t threads     threads for sorting runs (default: all cores)
+ *   -f fanIn       most runs per merge (default 64)
+ *   -d directory   directory for temporary runs (default .)
+ */
+
+void usage( )
+{
+    cerr << "Usage: externalSort -r recordBytes [-k offset:length] [-m megabytes]"
+         << " [-t threads] [-f fanIn] [-d tempDir] input output" << endl;
+    exit( 1 );
+}
+
+int main( int argc, char *argv[ ] )
+{
+    int recordSize = 0;
+    int keyOffset = 0, keyLength = -1;
+    long long megabytes = 256;
+    int threads = 0, fanIn = 0;
+    string tempDirectory = ".";
+    string files[ 2 ];
+    int numFiles = 0;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        string arg = argv[ i ];
+        if( arg.size( ) == 2 && arg[ 0 ] == '-' && i + 1 < argc )
+        {
+            string value = argv[ ++i ];
+            switch( arg[ 1 ] )
+            {
+              case 'r': recordSize = atoi( value.c_str( ) ); break;
+              case 'm': megabytes = atoll( value.c_str( ) ); break;
+              case 't': threads = atoi( value.c_str( ) ); break;
+              case 'f': fanIn = atoi( value.c_str( ) ); break;
+              case 'd': tempDirectory = value; break;
+              case 'k':
+                keyOffset = atoi( value.c_str( ) );
+                if( value.find( ':' ) == string::npos )
+                    usage( );
+                keyLength = atoi( value.c_str( ) + value.find( ':' ) + 1 );
+                break;
+              default: usage( );
+            }
+        }
+        else if( numFiles < 2 )
+            files[ numFiles++ ] = arg;
+        else
+            usage( );
+    }
+    if( recordSize <= 0 || numFiles != 2 )
+        usage( );
+
+    ExternalSortOptions options{ recordSize };
+    options.keyOffset = keyOffset;
+    options.keyLength = keyLength < 0 ? recordSize - keyOffset : keyLength;
+    options.memoryBytes = megabytes << 20;
+    options.tempDirectory = tempDirectory;
+    if( threads > 0 )
+        options.numThreads = threads;
+    if( fanIn > 0 )
+        options.maxFanIn = fanIn;
+
+    try
+    {
+        ExternalSortStats stats = externalSort( files[ 0 ], files[ 1 ], options );
+        double megs = stats.bytes / double( 1 << 20 );
+        double total = stats.runSeconds + stats.mergeSeconds;
+
+        cout << fixed << setprecision( 2 );
+        cout << stats.records << " records, " << megs << " MB" << endl;
+        cout << "Runs:  " << stats.runs << " in " << stats.runSeconds << " s, "
+             << megs / stats.runSeconds << " MB/s" << endl;
+        if( stats.mergePasses > 0 )
+            cout << "Merge: " << stats.mergePasses << " pass(es) in " << stats.mergeSeconds
+                 << " s, " << megs * stats.mergePasses / stats.mergeSeconds << " MB/s" << endl;
+        cout << "Total: " << total << " s, " << megs / total << " MB/s" << endl;
+    }
+    catch( const exception & e )
+    {
+        cerr << "externalSort: " << e.what( ) << endl;
+        return 1;
+    }
+
+    return 0;
+}
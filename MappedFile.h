@@ -0,0 +1,133 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+// Helpers for index files that are written once and then used in
+// place through mmap
+//
+// CONSTRUCTION: MappedFile with the name of the file to map.
+//
+// ******************PUBLIC OPERATIONS*********************
+// const unsigned char * data( )  --> The file's bytes (nullptr if empty)
+// long long size( )              --> Its length
+// uint64_t checksum( bytes, n, sum )
+//                                --> Checksum of bytes[0..n-1], continuing
+//                                    from sum (0 to start)
+// void writeFileAtomically( fileName, write )
+//                                --> Call write( out ) on a stream to a
+//                                    temporary file, then rename it to
+//                                    fileName
+// ******************ERRORS********************************
+// MappedFile throws invalid_argument if the file cannot be opened and
+// runtime_error if it cannot be mapped; writeFileAtomically throws
+// runtime_error if the file cannot be written, and leaves no
+// temporary file behind.
+//
+// The mapping is read-only and private, so every process that maps
+// the same file shares its pages through the page cache. Because a
+// finished file only ever appears by rename, a reader sees either the
+// old file or all of the new one, never a partial write.
+
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class MappedFile
+{
+  public:
+    explicit MappedFile( const std::string & fileName )
+      : fd{ open( fileName.c_str( ), O_RDONLY ) }, bytes{ nullptr }, length{ 0 }
+    {
+        struct stat info;
+        if( fd < 0 || fstat( fd, &info ) != 0 )
+        {
+            if( fd >= 0 )
+                close( fd );
+            throw std::invalid_argument{ "Cannot open " + fileName };
+        }
+
+        length = info.st_size;
+        if( length > 0 )
+        {
+            void *p = mmap( nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if( p == MAP_FAILED )
+            {
+                close( fd );
+                throw std::runtime_error{ "Cannot map " + fileName };
+            }
+            bytes = static_cast<unsigned char *>( p );
+        }
+    }
+
+    ~MappedFile( )
+    {
+        if( bytes != nullptr )
+            munmap( bytes, length );
+        if( fd >= 0 )
+            close( fd );
+    }
+
+    MappedFile( const MappedFile & rhs ) = delete;
+    MappedFile & operator= ( const MappedFile & rhs ) = delete;
+
+    const unsigned char * data( ) const
+      { return bytes; }
+    long long size( ) const
+      { return length; }
+
+  private:
+    int fd;
+    unsigned char *bytes;
+    long long length;
+};
+
+/**
+ * Each 8-byte word is mixed in with a multiply and a shift, and the
+ * length is folded in at the end. Meant to catch torn or corrupted
+ * files, not tampering.
+ */
+inline uint64_t checksum( const void *data, uint64_t n, uint64_t sum = 0 )
+{
+    const uint64_t PRIME = 0x9e3779b97f4a7c15ULL;
+    const unsigned char *bytes = static_cast<const unsigned char *>( data );
+    uint64_t i = 0;
+
+    for( ; i + 8 <= n; i += 8 )
+    {
+        uint64_t w;
+        memcpy( &w, bytes + i, 8 );
+        sum = ( sum ^ w ) * PRIME;
+        sum ^= sum >> 29;
+    }
+
+    uint64_t tail = 0;
+    if( n > i )
+        memcpy( &tail, bytes + i, n - i );
+    sum = ( sum ^ tail ^ n ) * PRIME;
+    return sum ^ ( sum >> 32 );
+}
+
+template <typename Writer>
+void writeFileAtomically( const std::string & fileName, Writer write )
+{
+    std::string tmpName = fileName + ".tmp";
+    std::ofstream out{ tmpName, std::ios::binary | std::ios::trunc };
+    if( !out )
+        throw std::runtime_error{ "Cannot create " + tmpName };
+
+    write( out );
+    out.close( );
+    if( !out || rename( tmpName.c_str( ), fileName.c_str( ) ) != 0 )
+    {
+        remove( tmpName.c_str( ) );
+        throw std::runtime_error{ "Cannot write " + fileName };
+    }
+}
+
+#endif
@@ -1,8 +1,16 @@
 #include <iostream>
+#include <iomanip>
+#include <fstream>
 #include <algorithm>
 #include <string>
 #include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <cstring>
+#include <cstdint>
 #include "UniformRandom.h"
+#include "RunOnThreads.h"
 using namespace std;
 
 
@@ -71,6 +79,88 @@ void countingRadixSort( vector<string> & arr, int stringLen )
             (*out)[ i ] = std::move( (*in)[ i ] );
 }
 
+/*
+ * Parallel counting radix sort an array of Strings
+ * Assume all have same length
+ * The strings are not moved by the passes. Instead each key is
+ * copied once, with its index, into a flat record of stringLen + 4
+ * bytes, and the passes scatter these records between two
+ * preallocated buffers, reading them sequentially. Each pass splits
+ * the records into one slice per thread; every thread counts the
+ * characters of its slice, and a prefix scan over (character, thread)
+ * gives each thread its own offsets, so the threads scatter
+ * concurrently and the pass stays stable. The strings are moved
+ * once, into sorted order, at the end.
+ */
+void parallelCountingRadixSort( vector<string> & arr, int stringLen,
+                                int numThreads = thread::hardware_concurrency( ) )
+{
+    const int BUCKETS = 256;
+
+    int N = arr.size( );
+    int stride = stringLen + sizeof( uint32_t );
+    numThreads = max( 1, min( numThreads, N / 4096 + 1 ) );
+
+    vector<char> records( (long long) N * stride );
+    vector<char> buffer( records.size( ) );
+    for( int i = 0; i < N; ++i )
+    {
+        uint32_t index = i;
+        memcpy( &records[ (long long) i * stride ], arr[ i ].data( ), stringLen );
+        memcpy( &records[ (long long) i * stride + stringLen ], &index, sizeof( index ) );
+    }
+
+    char *in = records.data( );
+    char *out = buffer.data( );
+    vector<vector<long long>> count( numThreads, vector<long long>( BUCKETS ) );
+
+
+    for( int pos = stringLen - 1; pos >= 0; --pos )
+    {
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            vector<long long> & myCount = count[ t ];
+            fill( begin( myCount ), end( myCount ), 0 );
+            for( int i = sliceBegin( N, t, numThreads ); i < sliceBegin( N, t + 1, numThreads ); ++i )
+                ++myCount[ static_cast<unsigned char>( in[ (long long) i * stride + pos ] ) ];
+        } );
+
+            // Turn counts into starting byte offsets, bucket-major
+        long long offset = 0;
+        for( int b = 0; b < BUCKETS; ++b )
+            for( int t = 0; t < numThreads; ++t )
+            {
+                long long c = count[ t ][ b ];
+                count[ t ][ b ] = offset;
+                offset += c * stride;
+            }
+
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            vector<long long> & next = count[ t ];
+            for( int i = sliceBegin( N, t, numThreads ); i < sliceBegin( N, t + 1, numThreads ); ++i )
+            {
+                const char *rec = in + (long long) i * stride;
+                long long & dest = next[ static_cast<unsigned char>( rec[ pos ] ) ];
+                memcpy( out + dest, rec, stride );
+                dest += stride;
+            }
+        } );
+
+            // swap in and out roles
+        std::swap( in, out );
+    }
+
+    vector<string> sorted( N );
+    for( int i = 0; i < N; ++i )
+    {
+        uint32_t index;
+        memcpy( &index, in + (long long) i * stride + stringLen, sizeof( index ) );
+        sorted[ i ] = std::move( arr[ index ] );
+    }
+    arr.swap( sorted );
+}
+
 /*
  * Radix sort an array of Strings
  * Assume all are all ASCII
@@ -110,7 +200,406 @@ void radixSort( vector<string> & arr, int maxLen )
     }
 }
 
-int main( )
+/*
+ * Internal method for the MSD string sorts.
+ * Returns the character of s at position d, shifted up one so
+ * that 0 can stand for "past the end of s"; shorter strings
+ * thus sort before their extensions.
+ */
+inline int charAt( const string & s, int d )
+{
+    return d < s.length( ) ? static_cast<unsigned char>( s[ d ] ) + 1 : 0;
+}
+
+/*
+ * Internal method for multikeyQuicksort.
+ * Insertion sort arr[lo..hi-1], whose strings all agree
+ * in their first depth characters.
+ */
+void insertionSortFrom( vector<string> & arr, int lo, int hi, int depth )
+{
+    for( int p = lo + 1; p < hi; ++p )
+    {
+        string tmp = std::move( arr[ p ] );
+        int j = p;
+
+        for( ; j > lo && tmp.compare( depth, string::npos,
+                                      arr[ j - 1 ], depth, string::npos ) < 0; --j )
+            arr[ j ] = std::move( arr[ j - 1 ] );
+        arr[ j ] = std::move( tmp );
+    }
+}
+
+/*
+ * Multikey quicksort (Bentley and Sedgewick) of arr[lo..hi-1],
+ * whose strings all agree in their first depth characters.
+ * Partitions three ways on the character at depth, so the
+ * strings equal to the pivot move on to the next character
+ * and are never compared on this one again.
+ */
+void multikeyQuicksort( vector<string> & arr, int lo, int hi, int depth )
+{
+    const int INSERTION_CUTOFF = 10;
+
+    while( hi - lo > INSERTION_CUTOFF )
+    {
+            // Median of three characters as the pivot
+        int a = charAt( arr[ lo ], depth );
+        int b = charAt( arr[ lo + ( hi - lo ) / 2 ], depth );
+        int c = charAt( arr[ hi - 1 ], depth );
+        int pivot = max( min( a, b ), min( max( a, b ), c ) );
+
+        int lt = lo, gt = hi, i = lo;
+        while( i < gt )
+        {
+            int ch = charAt( arr[ i ], depth );
+            if( ch < pivot )
+                swap( arr[ lt++ ], arr[ i++ ] );
+            else if( ch > pivot )
+                swap( arr[ i ], arr[ --gt ] );
+            else
+                ++i;
+        }
+
+        multikeyQuicksort( arr, lo, lt, depth );
+        multikeyQuicksort( arr, gt, hi, depth );
+
+        if( pivot == 0 )       // Equal strings that have all ended
+            return;
+        lo = lt;
+        hi = gt;
+        ++depth;
+    }
+
+    insertionSortFrom( arr, lo, hi, depth );
+}
+
+/*
+ * Multikey quicksort of an array of Strings (driver).
+ */
+void multikeyQuicksort( vector<string> & arr )
+{
+    multikeyQuicksort( arr, 0, arr.size( ), 0 );
+}
+
+/*
+ * American flag sort (McIlroy, Bostic, and McIlroy): in-place
+ * MSD radix sort of arr[lo..hi-1], whose strings all agree in
+ * their first depth characters. One scan builds the histogram of
+ * the character at depth; the strings are then swapped into their
+ * buckets by following cycles, with no second array. The bucket of
+ * strings that have ended is finished, so short strings cost no
+ * further passes; buckets smaller than MSD_CUTOFF go to
+ * multikeyQuicksort.
+ * The buckets still to sort are kept on an explicit stack rather
+ * than recursed into, so a long shared prefix cannot overflow the
+ * call stack; when every string falls in one bucket, the pass just
+ * moves on to the next character.
+ */
+void americanFlagSort( vector<string> & arr, int lo, int hi, int depth )
+{
+    const int BUCKETS = 257;    // 256 characters and end-of-string
+    const int MSD_CUTOFF = 32;
+
+    struct Bucket
+    {
+        int lo, hi, depth;
+    };
+    vector<Bucket> work{ { lo, hi, depth } };
+
+    while( !work.empty( ) )
+    {
+        Bucket bucket = work.back( );
+        work.pop_back( );
+        lo = bucket.lo;
+        hi = bucket.hi;
+        depth = bucket.depth;
+
+        if( hi - lo < MSD_CUTOFF )
+        {
+            multikeyQuicksort( arr, lo, hi, depth );
+            continue;
+        }
+
+        int count[ BUCKETS ] = { 0 };
+        for( int i = lo; i < hi; ++i )
+            ++count[ charAt( arr[ i ], depth ) ];
+
+        int only = charAt( arr[ lo ], depth );
+        if( count[ only ] == hi - lo )
+        {
+            if( only != 0 )         // All share this character
+                work.push_back( { lo, hi, depth + 1 } );
+            continue;
+        }
+
+        int next[ BUCKETS ], end[ BUCKETS ];
+        for( int b = 0, start = lo; b < BUCKETS; ++b )
+        {
+            next[ b ] = start;
+            start += count[ b ];
+            end[ b ] = start;
+        }
+
+            // Place each string; the one swapped in is placed next
+        for( int b = 0; b < BUCKETS; ++b )
+            while( next[ b ] < end[ b ] )
+            {
+                int c = charAt( arr[ next[ b ] ], depth );
+                if( c == b )
+                    ++next[ b ];
+                else
+                    swap( arr[ next[ b ] ], arr[ next[ c ]++ ] );
+            }
+
+        for( int b = 1; b < BUCKETS; ++b )
+            if( count[ b ] > 1 )
+                work.push_back( { end[ b ] - count[ b ], end[ b ], depth + 1 } );
+    }
+}
+
+/*
+ * American flag sort of an array of Strings (driver).
+ * Strings may have any length and any bytes.
+ */
+void americanFlagSort( vector<string> & arr )
+{
+    americanFlagSort( arr, 0, arr.size( ), 0 );
+}
+
+/*
+ * A string in cachedPrefixSort: the 8 bytes of the string that
+ * start at the current depth, as a big-endian integer, and the
+ * string itself. Comparing the words orders strings by those 8
+ * bytes without following the pointer.
+ */
+struct CachedPrefix
+{
+    uint64_t word;
+    string *str;
+};
+
+/*
+ * Internal method for cachedPrefixSort.
+ * Returns s[d..d+7] as a big-endian word, padded with zero bytes.
+ */
+inline uint64_t prefixWord( const string & s, int d )
+{
+    uint64_t word = 0;
+    int end = min<int>( d + 8, s.length( ) );
+
+    for( int i = d; i < end; ++i )
+        word |= uint64_t( static_cast<unsigned char>( s[ i ] ) ) << ( 8 * ( d + 7 - i ) );
+    return word;
+}
+
+/*
+ * Internal method for cachedPrefixSort.
+ * Insertion sort arr[lo..hi-1], whose strings agree in their first
+ * depth characters; strings are read only when their words tie.
+ */
+void insertionSortFrom( vector<CachedPrefix> & arr, int lo, int hi, int depth )
+{
+    for( int p = lo + 1; p < hi; ++p )
+    {
+        CachedPrefix tmp = arr[ p ];
+        int j = p;
+
+        for( ; j > lo; --j )
+        {
+            const CachedPrefix & prev = arr[ j - 1 ];
+            if( tmp.word != prev.word ? tmp.word > prev.word
+                                      : tmp.str->compare( depth, string::npos,
+                                                          *prev.str, depth, string::npos ) >= 0 )
+                break;
+            arr[ j ] = prev;
+        }
+        arr[ j ] = tmp;
+    }
+}
+
+/*
+ * Internal method for cachedPrefixSort: multikey quicksort on whole
+ * words. Sorts arr[lo..hi-1], whose strings agree in their first
+ * depth characters and whose words hold the next 8. Partitions
+ * three ways on the word; only the strings whose words tie with the
+ * pivot are read, to load their next 8 bytes. Strings that end within
+ * the tied word go first, in order of length (they differ only in
+ * trailing zero bytes, if at all).
+ */
+void cachedPrefixSort( vector<CachedPrefix> & arr, int lo, int hi, int depth )
+{
+    const int INSERTION_CUTOFF = 16;
+
+    while( hi - lo > INSERTION_CUTOFF )
+    {
+        uint64_t a = arr[ lo ].word;
+        uint64_t b = arr[ lo + ( hi - lo ) / 2 ].word;
+        uint64_t c = arr[ hi - 1 ].word;
+        uint64_t pivot = max( min( a, b ), min( max( a, b ), c ) );
+
+        int lt = lo, gt = hi, i = lo;
+        while( i < gt )
+        {
+            if( arr[ i ].word < pivot )
+                swap( arr[ lt++ ], arr[ i++ ] );
+            else if( arr[ i ].word > pivot )
+                swap( arr[ i ], arr[ --gt ] );
+            else
+                ++i;
+        }
+
+        cachedPrefixSort( arr, lo, lt, depth );
+        cachedPrefixSort( arr, gt, hi, depth );
+
+            // Refine the ties: finished strings first, by length
+        depth += 8;
+        auto done = partition( begin( arr ) + lt, begin( arr ) + gt,
+                               [ depth ] ( const CachedPrefix & p ) { return p.str->length( ) <= depth; } );
+        sort( begin( arr ) + lt, done, [ ] ( const CachedPrefix & p, const CachedPrefix & q )
+                                         { return p.str->length( ) < q.str->length( ); } );
+        lo = done - begin( arr );
+        hi = gt;
+        for( int j = lo; j < hi; ++j )
+            arr[ j ].word = prefixWord( *arr[ j ].str, depth );
+    }
+
+    insertionSortFrom( arr, lo, hi, depth );
+}
+
+/*
+ * Cached-prefix string sort of an array of Strings (driver).
+ * Sorts 16-byte (word, pointer) pairs instead of the strings,
+ * so most comparisons touch no string data; meant for keys such
+ * as URL paths, which share long prefixes and would otherwise
+ * cost a cache miss per comparison. The strings are moved once,
+ * into sorted order, at the end.
+ */
+void cachedPrefixSort( vector<string> & arr )
+{
+    int N = arr.size( );
+    vector<CachedPrefix> keys( N );
+
+    for( int i = 0; i < N; ++i )
+        keys[ i ] = CachedPrefix{ prefixWord( arr[ i ], 0 ), &arr[ i ] };
+    cachedPrefixSort( keys, 0, N, 0 );
+
+    vector<string> sorted( N );
+    for( int i = 0; i < N; ++i )
+        sorted[ i ] = std::move( *keys[ i ].str );
+    arr.swap( sorted );
+}
+
+/*
+ * Return the lines of fileName, shuffled; empty if it cannot be read.
+ */
+vector<string> readWords( const string & fileName )
+{
+    ifstream in{ fileName };
+    vector<string> words;
+    UniformRandom r{ 4 };
+
+    for( string line; getline( in, line ); )
+        words.push_back( line );
+    for( int j = 1; j < words.size( ); ++j )
+        swap( words[ j ], words[ r.nextInt( 0, j ) ] );
+    return words;
+}
+
+/*
+ * Return n keys like those of a web server log: a timestamp, a host,
+ * and a URL path, with long shared prefixes and varying lengths.
+ */
+vector<string> makeLogKeys( int n )
+{
+    const char *paths[ ] = { "/api/v1/users/", "/api/v1/orders/", "/api/v2/users/",
+                             "/static/img/", "/search?q=" };
+    vector<string> keys;
+    UniformRandom r{ 8 };
+
+    for( int i = 0; i < n; ++i )
+        keys.push_back( "2024-05-" + to_string( 10 + r.nextInt( 10 ) )
+                        + "T" + to_string( 10 + r.nextInt( 14 ) ) + ":" + to_string( 10 + r.nextInt( 50 ) )
+                        + " host-" + to_string( r.nextInt( 40 ) ) + " "
+                        + paths[ r.nextInt( 5 ) ] + to_string( r.nextInt( 1000000 ) ) );
+    return keys;
+}
+
+/*
+ * Return n URL paths that share long prefixes, like the keys
+ * of a web cache.
+ */
+vector<string> makeUrlPaths( int n )
+{
+    const char *services[ ] = { "/api/internal/accounts/", "/api/internal/accounts-archive/",
+                                "/content/delivery/static/assets/" };
+    vector<string> paths;
+    UniformRandom r{ 16 };
+
+    for( int i = 0; i < n; ++i )
+        paths.push_back( services[ r.nextInt( 3 ) ] + to_string( 100000 + r.nextInt( 5000 ) )
+                         + "/orders/" + to_string( r.nextInt( 100 ) ) + "/items/" + to_string( r.nextInt( 1000 ) ) );
+    return paths;
+}
+
+template <typename Sort>
+void timeSort( const string & name, const vector<string> & words, const vector<string> & expected,
+               Sort sortWords )
+{
+    vector<string> arr = words;
+
+    auto start = chrono::steady_clock::now( );
+    sortWords( arr );
+    double seconds = chrono::duration<double>( chrono::steady_clock::now( ) - start ).count( );
+
+    cout << "  " << setw( 20 ) << left << name << right << fixed << setprecision( 3 )
+         << setw( 8 ) << seconds << ( arr == expected ? "" : "  OOPS!!" ) << endl;
+}
+
+/*
+ * Time the string sorts on one set of keys. countingRadixSort and
+ * radixSortA need keys of equal length; fixedLen is that length,
+ * or 0 if the keys vary.
+ */
+void benchmark( const string & name, const vector<string> & words, int fixedLen )
+{
+    vector<string> expected = words;
+    sort( begin( expected ), end( expected ) );
+
+    int maxLen = 0;
+    for( const string & s : words )
+        maxLen = max<int>( maxLen, s.length( ) );
+
+    cout << name << ": " << words.size( ) << " keys, seconds" << endl;
+    timeSort( "std::sort", words, expected,
+              [ ] ( vector<string> & arr ) { sort( begin( arr ), end( arr ) ); } );
+    if( fixedLen > 0 )
+    {
+        timeSort( "countingRadixSort", words, expected,
+                  [ = ] ( vector<string> & arr ) { countingRadixSort( arr, fixedLen ); } );
+        int maxThreads = max( 1u, thread::hardware_concurrency( ) );
+        for( int threads = 1; threads <= maxThreads; threads *= 2 )
+            timeSort( "parallel, " + to_string( threads ) + " thr", words, expected,
+                      [ = ] ( vector<string> & arr ) { parallelCountingRadixSort( arr, fixedLen, threads ); } );
+    }
+    timeSort( "radixSort", words, expected,
+              [ = ] ( vector<string> & arr ) { radixSort( arr, maxLen ); } );
+    timeSort( "multikeyQuicksort", words, expected,
+              [ ] ( vector<string> & arr ) { multikeyQuicksort( arr ); } );
+    timeSort( "americanFlagSort", words, expected,
+              [ ] ( vector<string> & arr ) { americanFlagSort( arr ); } );
+    timeSort( "cachedPrefixSort", words, expected,
+              [ ] ( vector<string> & arr ) { cachedPrefixSort( arr ); } );
+}
+
+/*
+ * Usage: RadixSort [bench [dictFile [numLogKeys]]]
+ * With no arguments, checks the sorts against std::sort.
+ * bench times them on 1,000,000 random 12-letter strings,
+ * the words of dictFile (default dict.txt), and numLogKeys
+ * (default 2,000,000) generated log keys and URL paths.
+ */
+int main( int argc, char *argv[ ] )
 {
     vector<string> lst;
     UniformRandom r;
@@ -129,6 +618,15 @@ int main( )
         lst.push_back( str );
     }
 
+    if( argc > 1 && string( argv[ 1 ] ) == "bench" )
+    {
+        benchmark( "random", lst, LEN + ADD );
+        benchmark( "dictionary", readWords( argc > 2 ? argv[ 2 ] : "dict.txt" ), 0 );
+        benchmark( "log keys", makeLogKeys( argc > 3 ? atoi( argv[ 3 ] ) : 2000000 ), 0 );
+        benchmark( "URL paths", makeUrlPaths( argc > 3 ? atoi( argv[ 3 ] ) : 2000000 ), 0 );
+        return 0;
+    }
+
     vector<string> arr1 = lst;
     vector<string> arr2 = lst;
 
@@ -138,8 +636,60 @@ int main( )
     for( int i = 0; i < arr1.size( ); ++i )
         if( arr1[ i ] != arr2[ i ] )
             cout << "OOPS!!" << endl;
-    
+
+        // Variable lengths, including empty strings and prefixes of others
+    vector<string> varied = makeLogKeys( 100000 );
+    for( int i = 0; i < 100000; ++i )
+        varied.push_back( lst[ i ].substr( 0, r.nextInt( LEN + ADD ) ) );
+    vector<string> expected = varied;
+    sort( begin( expected ), end( expected ) );
+
+    for( int threads = 1; threads <= 8; threads *= 2 )
+    {
+        arr2 = lst;
+        parallelCountingRadixSort( arr2, LEN + ADD, threads );
+        if( arr1 != arr2 )
+            cout << "OOPS!! parallelCountingRadixSort, " << threads << " threads" << endl;
+    }
+
+    arr2 = lst;
+    americanFlagSort( arr2 );
+    if( arr1 != arr2 )
+        cout << "OOPS!! americanFlagSort" << endl;
+    arr2 = varied;
+    americanFlagSort( arr2 );
+    if( expected != arr2 )
+        cout << "OOPS!! americanFlagSort on varied lengths" << endl;
+    arr2 = varied;
+    multikeyQuicksort( arr2 );
+    if( expected != arr2 )
+        cout << "OOPS!! multikeyQuicksort on varied lengths" << endl;
+
+        // A long shared prefix, and a staircase of prefixes, each one
+        // pass of the radix sort per shared character
+    vector<string> shared;
+    for( int i = 0; i < 100; ++i )
+        shared.push_back( string( 3000, 'p' ) + to_string( r.nextInt( 0, 1000000 ) ) );
+    for( int i = 1; i <= 3000; ++i )
+        shared.push_back( string( i, 'q' ) );
+    expected = shared;
+    sort( begin( expected ), end( expected ) );
+    arr2 = shared;
+    americanFlagSort( arr2 );
+    if( expected != arr2 )
+        cout << "OOPS!! americanFlagSort on long shared prefixes" << endl;
+
+    for( int i = 0; i < 1000; ++i )     // Trailing zero bytes, within a word and past it
+        varied.push_back( string( "ab\0\0\0\0\0\0\0\0\0x", r.nextInt( 1, 12 ) ) );
+    varied.push_back( "" );
+    vector<string> paths = makeUrlPaths( 10000 );
+    varied.insert( end( varied ), begin( paths ), end( paths ) );
+    expected = varied;
+    sort( begin( expected ), end( expected ) );
+    arr2 = varied;
+    cachedPrefixSort( arr2 );
+    if( expected != arr2 )
+        cout << "OOPS!! cachedPrefixSort on varied lengths" << endl;
+
     return 0;
 }
-    
-
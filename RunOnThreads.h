@@ -0,0 +1,39 @@
+#ifndef RUN_ON_THREADS_H
+#define RUN_ON_THREADS_H
+
+// Fork-join helpers for splitting a loop over threads
+//
+// ******************PUBLIC OPERATIONS*********************
+// void runOnThreads( numThreads, f )   --> Run f( t ) for t = 0..numThreads-1,
+//                                          each on its own thread (f( 0 ) on
+//                                          the caller's), and wait for all
+// long long sliceBegin( n, t, numThreads )
+//                                      --> First index of slice t when n
+//                                          items are split numThreads ways
+// ******************ERRORS********************************
+// An exception escaping f on another thread terminates the program.
+//
+// A typical loop gives thread t the items
+//     sliceBegin( n, t, numThreads ) .. sliceBegin( n, t + 1, numThreads ) - 1
+
+#include <vector>
+#include <thread>
+
+template <typename Function>
+void runOnThreads( int numThreads, Function f )
+{
+    std::vector<std::thread> threads;
+
+    for( int t = 1; t < numThreads; ++t )
+        threads.push_back( std::thread{ f, t } );
+    f( 0 );
+    for( std::thread & th : threads )
+        th.join( );
+}
+
+inline long long sliceBegin( long long n, int t, int numThreads )
+{
+    return n * t / numThreads;
+}
+
+#endif
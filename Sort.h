@@ -8,8 +8,22 @@
 
 #include <vector>
 #include <functional>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include "WorkStealingPool.h"
+#include "SortingNetwork.h"
 using namespace std;
 
+template <typename Comparable>
+void percDown( vector<Comparable> & a, int i, int n );
+template <typename Comparable>
+void merge( vector<Comparable> & a, vector<Comparable> & tmpArray,
+            int leftPos, int rightPos, int rightEnd );
+
 /**
  * Simple insertion sort.
  */
@@ -49,6 +63,41 @@ void insertionSort( vector<Comparable> & a, int left, int right )
     }
 }
 
+/**
+ * Internal method that sorts the small subarrays left over
+ * by quicksort, quickSelect, and mergeSort. Primitive keys
+ * go through a sorting network; other types are insertion sorted.
+ */
+template <typename Comparable>
+void smallSort( vector<Comparable> & a, int left, int right, true_type )
+{
+    if( left < right )
+        networkSort( &a[ left ], right - left + 1 );
+}
+
+template <typename Comparable>
+void smallSort( vector<Comparable> & a, int left, int right, false_type )
+{
+    insertionSort( a, left, right );
+}
+
+template <typename Comparable>
+void smallSort( vector<Comparable> & a, int left, int right )
+{
+    smallSort( a, left, right, isNetworkSortable<Comparable>{ } );
+}
+
+/**
+ * Size at or below which quicksort and quickSelect
+ * hand a subarray to smallSort: 10 for general items,
+ * and the largest sorting network for primitive keys.
+ */
+template <typename Comparable>
+constexpr int smallSortCutoff( )
+{
+    return isNetworkSortable<Comparable>::value ? NETWORK_CUTOFF : 10;
+}
+
 
 
 /**
@@ -119,8 +168,52 @@ void percDown( vector<Comparable> & a, int i, int n )
     a[ i ] = std::move( tmp );
 }
 
+/**
+ * Internal method for heapsort of a subarray.
+ * The heap occupies a[left..left+n-1], with its root at a[left].
+ * i is the position, relative to left, from which to percolate down.
+ * n is the logical size of the binary heap.
+ */
+template <typename Comparable>
+void percDown( vector<Comparable> & a, int left, int i, int n )
+{
+    int child;
+    Comparable tmp = std::move( a[ left + i ] );
+
+    for( ; leftChild( i ) < n; i = child )
+    {
+        child = leftChild( i );
+        if( child != n - 1 && a[ left + child ] < a[ left + child + 1 ] )
+            ++child;
+        if( tmp < a[ left + child ] )
+            a[ left + i ] = std::move( a[ left + child ] );
+        else
+            break;
+    }
+    a[ left + i ] = std::move( tmp );
+}
+
+/**
+ * Heapsort of the subarray a[left..right].
+ */
+template <typename Comparable>
+void heapsort( vector<Comparable> & a, int left, int right )
+{
+    int n = right - left + 1;
+
+    for( int i = n / 2 - 1; i >= 0; --i )          /* buildHeap */
+        percDown( a, left, i, n );
+    for( int j = n - 1; j > 0; --j )
+    {
+        std::swap( a[ left ], a[ left + j ] );     /* deleteMax */
+        percDown( a, left, 0, j );
+    }
+}
+
 /**
  * Internal method that makes recursive calls.
+ * Subarrays of primitive keys that fit a sorting network
+ * are sorted by smallSort.
  * a is an array of Comparable items.
  * tmpArray is an array to place the merged result.
  * left is the left-most index of the subarray.
@@ -130,7 +223,9 @@ template <typename Comparable>
 void mergeSort( vector<Comparable> & a,
                 vector<Comparable> & tmpArray, int left, int right )
 {
-    if( left < right )
+    if( isNetworkSortable<Comparable>::value && right - left < NETWORK_CUTOFF )
+        smallSort( a, left, right );
+    else if( left < right )
     {
         int center = ( left + right ) / 2;
         mergeSort( a, tmpArray, left, center );
@@ -185,163 +280,1765 @@ void merge( vector<Comparable> & a, vector<Comparable> & tmpArray,
         a[ rightEnd ] = std::move( tmpArray[ rightEnd ] );
 }
 
+/*
+ * Bottom-up mergesort.
+ * Runs of MERGE_RUN items are sorted first, and then runs are merged
+ * pairwise, doubling in length, with each pass moving items from one
+ * array into the other (a to scratch, then scratch to a, and so on),
+ * so nothing is copied back after a merge. Merges switch to galloping
+ * (exponential search) when one run keeps winning, so runs that are
+ * already in order, or nearly so, merge in far fewer comparisons.
+ */
+
+const int MERGE_RUN = 32;
+const int MIN_GALLOP = 7;
 
 /**
- * Return median of left, center, and right.
- * Order these and hide the pivot.
+ * Internal method for galloping merges.
+ * v[base..base+len-1] is sorted. Returns the number of its items that
+ * are less than key, searching exponentially from base.
  */
 template <typename Comparable>
-const Comparable & median3( vector<Comparable> & a, int left, int right )
+int gallopLeft( const Comparable & key, const vector<Comparable> & v, int base, int len )
 {
-    int center = ( left + right ) / 2;
-    
-    if( a[ center ] < a[ left ] )
-        std::swap( a[ left ], a[ center ] );
-    if( a[ right ] < a[ left ] )
-        std::swap( a[ left ], a[ right ] );
-    if( a[ right ] < a[ center ] )
-        std::swap( a[ center ], a[ right ] );
+    int lo = 0, hi = 1;
 
-        // Place pivot at position right - 1
-    std::swap( a[ center ], a[ right - 1 ] );
-    return a[ right - 1 ];
+    while( hi < len && v[ base + hi - 1 ] < key )
+    {
+        lo = hi;
+        hi = 2 * hi + 1;
+    }
+    hi = std::min( hi, len );
+
+    return lower_bound( begin( v ) + base + lo, begin( v ) + base + hi, key )
+               - ( begin( v ) + base );
 }
 
 /**
- * Internal quicksort method that makes recursive calls.
- * Uses median-of-three partitioning and a cutoff of 10.
- * a is an array of Comparable items.
- * left is the left-most index of the subarray.
- * right is the right-most index of the subarray.
+ * Internal method for galloping merges.
+ * v[base..base+len-1] is sorted. Returns the number of its items that
+ * are less than or equal to key, searching exponentially from base.
  */
 template <typename Comparable>
-void quicksort( vector<Comparable> & a, int left, int right )
+int gallopRight( const Comparable & key, const vector<Comparable> & v, int base, int len )
 {
-    if( left + 10 <= right )
+    int lo = 0, hi = 1;
+
+    while( hi < len && !( key < v[ base + hi - 1 ] ) )
     {
-        const Comparable & pivot = median3( a, left, right );
+        lo = hi;
+        hi = 2 * hi + 1;
+    }
+    hi = std::min( hi, len );
 
-            // Begin partitioning
-        int i = left, j = right - 1;
-        for( ; ; )
-        {
-            while( a[ ++i ] < pivot ) { }
-            while( pivot < a[ --j ] ) { }
-            if( i < j )
-                std::swap( a[ i ], a[ j ] );
+    return upper_bound( begin( v ) + base + lo, begin( v ) + base + hi, key )
+               - ( begin( v ) + base );
+}
+
+/**
+ * Internal method for galloping merges.
+ * Stably merges the sorted runs left[i..mid-1] and right[j..hi-1]
+ * into dst, starting at dst[k]. Items are compared one at a time until
+ * one run has won MIN_GALLOP times in a row, and then whole stretches
+ * are located by galloping and moved in bulk.
+ * right and dst may be the same array if k <= j, since the
+ * write position then never passes the read position.
+ */
+template <typename Comparable>
+void gallopingMerge( vector<Comparable> & left, int i, int mid,
+                     vector<Comparable> & right, int j, int hi,
+                     vector<Comparable> & dst, int k )
+{
+    while( i < mid && j < hi )
+    {
+        int leftWins = 0, rightWins = 0;
+
+            // One item at a time
+        while( i < mid && j < hi
+               && leftWins < MIN_GALLOP && rightWins < MIN_GALLOP )
+            if( right[ j ] < left[ i ] )
+            {
+                dst[ k++ ] = std::move( right[ j++ ] );
+                ++rightWins;
+                leftWins = 0;
+            }
             else
+            {
+                dst[ k++ ] = std::move( left[ i++ ] );
+                ++leftWins;
+                rightWins = 0;
+            }
+
+            // Galloping, until neither run wins a long stretch
+        while( i < mid && j < hi )
+        {
+            int leftCount = gallopRight( right[ j ], left, i, mid - i );
+            k = std::move( begin( left ) + i, begin( left ) + i + leftCount,
+                           begin( dst ) + k ) - begin( dst );
+            i += leftCount;
+            if( i == mid )
+                break;
+            dst[ k++ ] = std::move( right[ j++ ] );
+            if( j == hi )
+                break;
+
+            int rightCount = gallopLeft( left[ i ], right, j, hi - j );
+            k = std::move( begin( right ) + j, begin( right ) + j + rightCount,
+                           begin( dst ) + k ) - begin( dst );
+            j += rightCount;
+            if( j == hi )
+                break;
+            dst[ k++ ] = std::move( left[ i++ ] );
+
+            if( leftCount < MIN_GALLOP && rightCount < MIN_GALLOP )
                 break;
         }
+    }
 
-        std::swap( a[ i ], a[ right - 1 ] );  // Restore pivot
+    k = std::move( begin( left ) + i, begin( left ) + mid, begin( dst ) + k ) - begin( dst );
+    if( &right != &dst || j != k )      // Otherwise the rest is in place
+        std::move( begin( right ) + j, begin( right ) + hi, begin( dst ) + k );
+}
 
-        quicksort( a, left, i - 1 );     // Sort small elements
-        quicksort( a, i + 1, right );    // Sort large elements
+/**
+ * Internal method for bottom-up mergesort.
+ * Stably merges the sorted runs src[lo..mid-1] and src[mid..hi-1]
+ * into dst[lo..hi-1].
+ */
+template <typename Comparable>
+void gallopingMerge( vector<Comparable> & src, vector<Comparable> & dst,
+                     int lo, int mid, int hi )
+{
+    if( mid < hi && !( src[ mid ] < src[ mid - 1 ] ) )
+        std::move( begin( src ) + lo, begin( src ) + hi, begin( dst ) + lo );
+    else
+        gallopingMerge( src, lo, mid, src, mid, hi, dst, lo );
+}
+
+/**
+ * Bottom-up mergesort, using scratch as the second array.
+ * scratch is grown to a.size( ) if it is smaller, and
+ * may be reused by the caller for the next sort.
+ */
+template <typename Comparable>
+void mergeSortBottomUp( vector<Comparable> & a, vector<Comparable> & scratch )
+{
+    int n = a.size( );
+    if( scratch.size( ) < a.size( ) )
+        scratch.resize( a.size( ) );
+
+    for( int lo = 0; lo < n; lo += MERGE_RUN )
+        smallSort( a, lo, std::min( lo + MERGE_RUN, n ) - 1 );
+
+    vector<Comparable> *src = &a;
+    vector<Comparable> *dst = &scratch;
+
+    for( int width = MERGE_RUN; width < n; width *= 2 )
+    {
+        for( int lo = 0; lo < n; lo += 2 * width )
+            gallopingMerge( *src, *dst, lo, std::min( lo + width, n ),
+                            std::min( lo + 2 * width, n ) );
+
+            // swap src and dst roles
+        std::swap( src, dst );
     }
-    else  // Do an insertion sort on the subarray
-        insertionSort( a, left, right );
+
+        // After an odd number of passes, the items are in scratch
+    if( src != &a )
+        std::move( begin( scratch ), begin( scratch ) + n, begin( a ) );
 }
 
 /**
- * Quicksort algorithm (driver).
+ * Bottom-up mergesort (driver).
+ * The scratch array is kept per thread and per item type,
+ * so repeated sorts allocate only when an array outgrows it.
  */
 template <typename Comparable>
-void quicksort( vector<Comparable> & a )
+void mergeSortBottomUp( vector<Comparable> & a )
 {
-    quicksort( a, 0, a.size( ) - 1 );
+    static thread_local vector<Comparable> scratch;
+
+    mergeSortBottomUp( a, scratch );
 }
 
+// MergeSortArena class
+//
+// CONSTRUCTION: with an optional initial capacity
+//
+// ******************PUBLIC OPERATIONS*********************
+// void sort( a )         --> Stably sort a by bottom-up mergesort
+// void sortAll( arrays ) --> Sort each array in arrays
+// int capacity( )        --> Return the current scratch size
+// void release( )        --> Free the scratch space
+// ******************ERRORS********************************
+// No error checking is performed
 
 /**
- * Internal selection method that makes recursive calls.
- * Uses median-of-three partitioning and a cutoff of 10.
- * Places the kth smallest item in a[k-1].
- * a is an array of Comparable items.
- * left is the left-most index of the subarray.
- * right is the right-most index of the subarray.
- * k is the desired rank (1 is minimum) in the entire array.
+ * Owns the scratch space for bottom-up mergesort, so that sorting
+ * many arrays allocates once (for the largest) rather than per sort.
  */
 template <typename Comparable>
-void quickSelect( vector<Comparable> & a, int left, int right, int k )
+class MergeSortArena
 {
-    if( left + 10 <= right )
+  public:
+    explicit MergeSortArena( int initialCapacity = 0 )
+      : scratch( initialCapacity )
     {
-        const Comparable & pivot = median3( a, left, right );
+    }
 
-            // Begin partitioning
-        int i = left, j = right - 1;
-        for( ; ; )
-        {
-            while( a[ ++i ] < pivot ) { }
-            while( pivot < a[ --j ] ) { }
-            if( i < j )
-                std::swap( a[ i ], a[ j ] );
+    void sort( vector<Comparable> & a )
+      { mergeSortBottomUp( a, scratch ); }
+
+    void sortAll( vector<vector<Comparable>> & arrays )
+    {
+        for( vector<Comparable> & a : arrays )
+            sort( a );
+    }
+
+    int capacity( ) const
+      { return scratch.size( ); }
+
+    void release( )
+      { vector<Comparable>( ).swap( scratch ); }
+
+  private:
+    vector<Comparable> scratch;
+};
+
+
+/*
+ * Timsort: an adaptive, stable mergesort.
+ * The array is scanned for natural runs (nondecreasing, or strictly
+ * decreasing and then reversed); runs shorter than minRun are extended
+ * by binary insertion sort. Runs are pushed on a stack whose lengths
+ * are kept growing faster than the Fibonacci numbers, merging as
+ * needed, so merges stay balanced and the stack stays logarithmic.
+ * Each merge first gallops to skip the prefix and suffix that are
+ * already in place, then copies only the shorter run to a temporary
+ * array and merges with galloping. Input made of k sorted batches
+ * sorts in O( N log k ) time.
+ */
+
+/**
+ * Internal method for timSort.
+ * Insertion sort of a[lo..hi-1], where a[lo..start-1] is already
+ * sorted, using binary search to find each insertion point.
+ */
+template <typename Comparable>
+void binaryInsertionSort( vector<Comparable> & a, int lo, int hi, int start )
+{
+    for( int p = start; p < hi; ++p )
+    {
+        Comparable tmp = std::move( a[ p ] );
+        int pos = upper_bound( begin( a ) + lo, begin( a ) + p, tmp ) - begin( a );
+
+        std::move_backward( begin( a ) + pos, begin( a ) + p, begin( a ) + p + 1 );
+        a[ pos ] = std::move( tmp );
+    }
+}
+
+/**
+ * Internal method for timSort.
+ * Returns the length of the run that starts at a[lo], ending before hi.
+ * A strictly decreasing run is reversed so that it ascends.
+ */
+template <typename Comparable>
+int countRunAndMakeAscending( vector<Comparable> & a, int lo, int hi )
+{
+    int runHi = lo + 1;
+    if( runHi == hi )
+        return 1;
+
+    if( a[ runHi++ ] < a[ lo ] )
+    {
+        while( runHi < hi && a[ runHi ] < a[ runHi - 1 ] )
+            ++runHi;
+        std::reverse( begin( a ) + lo, begin( a ) + runHi );
+    }
+    else
+        while( runHi < hi && !( a[ runHi ] < a[ runHi - 1 ] ) )
+            ++runHi;
+
+    return runHi - lo;
+}
+
+/**
+ * Internal method for timSort.
+ * Returns the minimum run length for an array of n items: n itself
+ * if n < 64, else a number between 32 and 64 such that n divided by
+ * it is, or is just below, a power of 2.
+ */
+inline int minRunLength( int n )
+{
+    int r = 0;      // Becomes 1 if any bit shifted off is 1
+
+    while( n >= 64 )
+    {
+        r |= n & 1;
+        n >>= 1;
+    }
+    return n + r;
+}
+
+/**
+ * Internal method for timSort.
+ * Stably merges the adjacent runs a[base1..base1+len1-1] and
+ * a[base2..base2+len2-1], len1 <= len2, by moving the first run
+ * to tmp and merging forward.
+ */
+template <typename Comparable>
+void mergeLo( vector<Comparable> & a, int base1, int len1, int base2, int len2,
+              vector<Comparable> & tmp )
+{
+    std::move( begin( a ) + base1, begin( a ) + base1 + len1, begin( tmp ) );
+    gallopingMerge( tmp, 0, len1, a, base2, base2 + len2, a, base1 );
+}
+
+/**
+ * Internal method for timSort.
+ * Stably merges the adjacent runs a[base1..base1+len1-1] and
+ * a[base2..base2+len2-1], len1 > len2, by moving the second run
+ * to tmp and merging backward from the right end.
+ */
+template <typename Comparable>
+void mergeHi( vector<Comparable> & a, int base1, int len1, int base2, int len2,
+              vector<Comparable> & tmp )
+{
+    std::move( begin( a ) + base2, begin( a ) + base2 + len2, begin( tmp ) );
+
+    int cursor1 = base1 + len1 - 1;     // Last item of run 1, in a
+    int cursor2 = len2 - 1;             // Last item of run 2, in tmp
+    int dest = base2 + len2 - 1;
+
+    while( cursor1 >= base1 && cursor2 >= 0 )
+    {
+        int leftWins = 0, rightWins = 0;
+
+            // One item at a time; the larger item goes last,
+            // and on ties the item of run 2 does
+        while( cursor1 >= base1 && cursor2 >= 0
+               && leftWins < MIN_GALLOP && rightWins < MIN_GALLOP )
+            if( tmp[ cursor2 ] < a[ cursor1 ] )
+            {
+                a[ dest-- ] = std::move( a[ cursor1-- ] );
+                ++leftWins;
+                rightWins = 0;
+            }
             else
+            {
+                a[ dest-- ] = std::move( tmp[ cursor2-- ] );
+                ++rightWins;
+                leftWins = 0;
+            }
+
+            // Galloping, until neither run wins a long stretch
+        while( cursor1 >= base1 && cursor2 >= 0 )
+        {
+            int size1 = cursor1 - base1 + 1;
+            int count1 = size1 - gallopRight( tmp[ cursor2 ], a, base1, size1 );
+            std::move_backward( begin( a ) + cursor1 + 1 - count1, begin( a ) + cursor1 + 1,
+                                begin( a ) + dest + 1 );
+            cursor1 -= count1;
+            dest -= count1;
+            if( cursor1 < base1 )
+                break;
+            a[ dest-- ] = std::move( tmp[ cursor2-- ] );
+            if( cursor2 < 0 )
                 break;
-        }
 
-        std::swap( a[ i ], a[ right - 1 ] );  // Restore pivot
+            int count2 = cursor2 + 1 - gallopLeft( a[ cursor1 ], tmp, 0, cursor2 + 1 );
+            std::move( begin( tmp ) + cursor2 + 1 - count2, begin( tmp ) + cursor2 + 1,
+                       begin( a ) + dest + 1 - count2 );
+            cursor2 -= count2;
+            dest -= count2;
+            if( cursor2 < 0 )
+                break;
+            a[ dest-- ] = std::move( a[ cursor1-- ] );
 
-            // Recurse; only this part changes
-        if( k <= i )
-            quickSelect( a, left, i - 1, k );
-        else if( k > i + 1 )
-            quickSelect( a, i + 1, right, k );
+            if( count1 < MIN_GALLOP && count2 < MIN_GALLOP )
+                break;
+        }
     }
-    else  // Do an insertion sort on the subarray
-        insertionSort( a, left, right );
+
+        // The rest of run 1, if any, is already in place
+    std::move( begin( tmp ), begin( tmp ) + cursor2 + 1, begin( a ) + dest - cursor2 );
 }
 
 /**
- * Quick selection algorithm.
- * Places the kth smallest item in a[k-1].
- * a is an array of Comparable items.
- * k is the desired rank (1 is minimum) in the entire array.
+ * Internal method for timSort.
+ * Merges runs i and i + 1 of the run stack.
  */
 template <typename Comparable>
-void quickSelect( vector<Comparable> & a, int k )
+void mergeAt( vector<Comparable> & a, vector<int> & runBase, vector<int> & runLen,
+              int i, vector<Comparable> & tmp )
 {
-    quickSelect( a, 0, a.size( ) - 1, k );
-}
+    int base1 = runBase[ i ], len1 = runLen[ i ];
+    int base2 = runBase[ i + 1 ], len2 = runLen[ i + 1 ];
+
+    runLen[ i ] = len1 + len2;
+    runBase.erase( begin( runBase ) + i + 1 );
+    runLen.erase( begin( runLen ) + i + 1 );
 
+        // Items of run 1 that are <= the first of run 2 are in place
+    int k = gallopRight( a[ base2 ], a, base1, len1 );
+    base1 += k;
+    len1 -= k;
+    if( len1 == 0 )
+        return;
+
+        // Items of run 2 that are >= the last of run 1 are in place
+    len2 = gallopLeft( a[ base1 + len1 - 1 ], a, base2, len2 );
+    if( len2 == 0 )
+        return;
+
+    if( tmp.size( ) < std::min( len1, len2 ) )
+        tmp.resize( std::min( len1, len2 ) );
 
+    if( len1 <= len2 )
+        mergeLo( a, base1, len1, base2, len2, tmp );
+    else
+        mergeHi( a, base1, len1, base2, len2, tmp );
+}
+
+/**
+ * Timsort algorithm (driver).
+ */
 template <typename Comparable>
-void SORT( vector<Comparable> & items )
+void timSort( vector<Comparable> & a )
 {
-    if( items.size( ) > 1 )
+    int n = a.size( );
+    if( n < 2 )
+        return;
+
+    int minRun = minRunLength( n );
+    vector<int> runBase;
+    vector<int> runLen;
+    vector<Comparable> tmp;
+
+    for( int lo = 0; lo < n; )
     {
-        vector<Comparable> smaller;
-        vector<Comparable> same;
-        vector<Comparable> larger;
-        
-        auto chosenItem = items[ items.size( ) / 2 ];
-        
-        for( auto & i : items )
+        int len = countRunAndMakeAscending( a, lo, n );
+
+        if( len < minRun )   // Extend short runs to minRun
         {
-            if( i < chosenItem )
-                smaller.push_back( std::move( i ) );
-            else if( chosenItem < i )
-                larger.push_back( std::move( i ) );
-            else
-                same.push_back( std::move( i ) );
+            int forced = std::min( minRun, n - lo );
+            binaryInsertionSort( a, lo, lo + forced, lo + len );
+            len = forced;
         }
-        
-        SORT( smaller );     // Recursive call!
-        SORT( larger );      // Recursive call!
-        
-        std::move( begin( smaller ), end( smaller ), begin( items ) );
-        std::move( begin( same ), end( same ), begin( items ) + smaller.size( ) );
-        std::move( begin( larger ), end( larger ), end( items ) - larger.size( ) );
 
-/*
-        items.clear( );
-        items.insert( end( items ), begin( smaller ), end( smaller ) );
-        items.insert( end( items ), begin( same ), end( same ) );
-        items.insert( end( items ), begin( larger ), end( larger ) );
-*/
+        runBase.push_back( lo );
+        runLen.push_back( len );
+        lo += len;
+
+            // Restore the invariants on the top of the run stack:
+            // runLen[ i - 2 ] > runLen[ i - 1 ] + runLen[ i ] and
+            // runLen[ i - 1 ] > runLen[ i ]
+        while( runLen.size( ) > 1 )
+        {
+            int i = runLen.size( ) - 2;
+            if( ( i > 0 && runLen[ i - 1 ] <= runLen[ i ] + runLen[ i + 1 ] )
+                || ( i > 1 && runLen[ i - 2 ] <= runLen[ i - 1 ] + runLen[ i ] ) )
+            {
+                if( runLen[ i - 1 ] < runLen[ i + 1 ] )
+                    --i;
+            }
+            else if( runLen[ i ] > runLen[ i + 1 ] )
+                break;
+            mergeAt( a, runBase, runLen, i, tmp );
+        }
+    }
+
+    while( runLen.size( ) > 1 )     // Merge all remaining runs
+    {
+        int i = runLen.size( ) - 2;
+        if( i > 0 && runLen[ i - 1 ] < runLen[ i + 1 ] )
+            --i;
+        mergeAt( a, runBase, runLen, i, tmp );
     }
 }
 
+
+/**
+ * Return median of left, center, and right.
+ * Order these and hide the pivot.
+ */
+template <typename Comparable>
+const Comparable & median3( vector<Comparable> & a, int left, int right )
+{
+    int center = ( left + right ) / 2;
+    
+    if( a[ center ] < a[ left ] )
+        std::swap( a[ left ], a[ center ] );
+    if( a[ right ] < a[ left ] )
+        std::swap( a[ left ], a[ right ] );
+    if( a[ right ] < a[ center ] )
+        std::swap( a[ center ], a[ right ] );
+
+        // Place pivot at position right - 1
+    std::swap( a[ center ], a[ right - 1 ] );
+    return a[ right - 1 ];
+}
+
+/**
+ * Internal method that partitions a subarray for quicksort
+ * and quickSelect, using median-of-three partitioning.
+ * a is an array of Comparable items.
+ * left is the left-most index of the subarray.
+ * right is the right-most index of the subarray.
+ * Requires that the subarray have more than 10 items.
+ * Returns the final position of the pivot.
+ */
+template <typename Comparable>
+int hoarePartition( vector<Comparable> & a, int left, int right )
+{
+    const Comparable & pivot = median3( a, left, right );
+
+        // Begin partitioning
+    int i = left, j = right - 1;
+    for( ; ; )
+    {
+        while( a[ ++i ] < pivot ) { }
+        while( pivot < a[ --j ] ) { }
+        if( i < j )
+            std::swap( a[ i ], a[ j ] );
+        else
+            break;
+    }
+
+    std::swap( a[ i ], a[ right - 1 ] );  // Restore pivot
+    return i;
+}
+
+/**
+ * Number of items in each block scanned by blockPartition.
+ */
+const int PARTITION_BLOCK = 128;
+
+/**
+ * Internal method that partitions a subarray exactly as
+ * hoarePartition does, but without data-dependent branches
+ * in the inner loops (BlockQuicksort). Each side scans a block,
+ * recording the offsets of the items that belong on the other side,
+ * and the recorded items are then swapped in bulk. The comparison
+ * result is added to a counter instead of being branched on.
+ * Meant for arithmetic types, where comparisons are cheap
+ * and mispredicted branches dominate.
+ */
+template <typename Comparable>
+int blockPartition( vector<Comparable> & a, int left, int right )
+{
+    const Comparable pivot = median3( a, left, right );
+
+    unsigned char offsetsL[ PARTITION_BLOCK ];
+    unsigned char offsetsR[ PARTITION_BLOCK ];
+    int startL = 0, numL = 0;
+    int startR = 0, numR = 0;
+
+        // a[left] <= pivot and a[right] >= pivot after median3,
+        // and the pivot itself is in a[right - 1]
+    int l = left + 1, r = right - 2;
+
+    while( r - l + 1 >= 2 * PARTITION_BLOCK )
+    {
+        if( numL == 0 )
+        {
+            startL = 0;
+            for( int k = 0; k < PARTITION_BLOCK; ++k )
+            {
+                offsetsL[ numL ] = k;
+                numL += !( a[ l + k ] < pivot );
+            }
+        }
+        if( numR == 0 )
+        {
+            startR = 0;
+            for( int k = 0; k < PARTITION_BLOCK; ++k )
+            {
+                offsetsR[ numR ] = k;
+                numR += !( pivot < a[ r - k ] );
+            }
+        }
+
+        int num = std::min( numL, numR );
+        for( int k = 0; k < num; ++k )
+            std::swap( a[ l + offsetsL[ startL + k ] ],
+                       a[ r - offsetsR[ startR + k ] ] );
+
+        numL -= num; startL += num;
+        numR -= num; startR += num;
+        if( numL == 0 )
+            l += PARTITION_BLOCK;
+        if( numR == 0 )
+            r -= PARTITION_BLOCK;
+    }
+
+        // Everything left of l is <= pivot and everything right of r
+        // is >= pivot, so the classic loop can finish the middle
+    int i = l - 1, j = r + 1;
+    for( ; ; )
+    {
+        while( a[ ++i ] < pivot ) { }
+        while( pivot < a[ --j ] ) { }
+        if( i < j )
+            std::swap( a[ i ], a[ j ] );
+        else
+            break;
+    }
+
+    std::swap( a[ i ], a[ right - 1 ] );  // Restore pivot
+    return i;
+}
+
+/**
+ * Internal method that partitions a subarray for quicksort
+ * and quickSelect, choosing the partitioning scheme by type.
+ */
+template <typename Comparable>
+int quicksortPartition( vector<Comparable> & a, int left, int right, true_type )
+{
+    return blockPartition( a, left, right );
+}
+
+template <typename Comparable>
+int quicksortPartition( vector<Comparable> & a, int left, int right, false_type )
+{
+    return hoarePartition( a, left, right );
+}
+
+/**
+ * Internal method that partitions a subarray for quicksort
+ * and quickSelect. Arithmetic types use blockPartition;
+ * everything else uses hoarePartition.
+ * Returns the final position of the pivot.
+ */
+template <typename Comparable>
+int quicksortPartition( vector<Comparable> & a, int left, int right )
+{
+    return quicksortPartition( a, left, right, is_arithmetic<Comparable>{ } );
+}
+
+/**
+ * Internal quicksort method that makes recursive calls.
+ * Uses median-of-three partitioning and the smallSortCutoff.
+ * a is an array of Comparable items.
+ * left is the left-most index of the subarray.
+ * right is the right-most index of the subarray.
+ */
+template <typename Comparable>
+void quicksort( vector<Comparable> & a, int left, int right )
+{
+    if( left + smallSortCutoff<Comparable>( ) <= right )
+    {
+        int i = quicksortPartition( a, left, right );
+
+        quicksort( a, left, i - 1 );     // Sort small elements
+        quicksort( a, i + 1, right );    // Sort large elements
+    }
+    else  // Do an insertion sort or sorting network on the subarray
+        smallSort( a, left, right );
+}
+
+/**
+ * Quicksort algorithm (driver).
+ */
+template <typename Comparable>
+void quicksort( vector<Comparable> & a )
+{
+    quicksort( a, 0, a.size( ) - 1 );
+}
+
+
+/**
+ * Internal selection method that makes recursive calls.
+ * Uses median-of-three partitioning and the smallSortCutoff.
+ * Places the kth smallest item in a[k-1].
+ * a is an array of Comparable items.
+ * left is the left-most index of the subarray.
+ * right is the right-most index of the subarray.
+ * k is the desired rank (1 is minimum) in the entire array.
+ */
+template <typename Comparable>
+void quickSelect( vector<Comparable> & a, int left, int right, int k )
+{
+    if( left + smallSortCutoff<Comparable>( ) <= right )
+    {
+        int i = quicksortPartition( a, left, right );
+
+            // Recurse; only this part changes
+        if( k <= i )
+            quickSelect( a, left, i - 1, k );
+        else if( k > i + 1 )
+            quickSelect( a, i + 1, right, k );
+    }
+    else  // Do an insertion sort or sorting network on the subarray
+        smallSort( a, left, right );
+}
+
+/**
+ * Quick selection algorithm.
+ * Places the kth smallest item in a[k-1].
+ * a is an array of Comparable items.
+ * k is the desired rank (1 is minimum) in the entire array.
+ */
+template <typename Comparable>
+void quickSelect( vector<Comparable> & a, int k )
+{
+    quickSelect( a, 0, a.size( ) - 1, k );
+}
+
+
+/**
+ * Subarrays smaller than this are sorted sequentially
+ * by the parallel sorting routines.
+ */
+const int PARALLEL_CUTOFF = 8192;
+
+/**
+ * Internal parallel quicksort method.
+ * Partitions exactly as quicksort does, hands the small
+ * elements to the pool as a new task, and keeps working
+ * on the large elements itself.
+ * pending counts the tasks that have not yet finished.
+ */
+template <typename Comparable>
+void parallelQuicksort( vector<Comparable> & a, int left, int right,
+                        WorkStealingPool & pool, atomic<int> & pending )
+{
+    while( left + PARALLEL_CUTOFF <= right )
+    {
+        int i = quicksortPartition( a, left, right );
+        int smallRight = i - 1;
+
+        ++pending;
+        pool.submit( [ &a, &pool, &pending, left, smallRight ]
+                     { parallelQuicksort( a, left, smallRight, pool, pending ); },
+                     pending );
+        left = i + 1;
+    }
+
+    quicksort( a, left, right );
+}
+
+/**
+ * Parallel quicksort algorithm (driver).
+ * numThreads is the total number of threads to use.
+ */
+template <typename Comparable>
+void parallelQuicksort( vector<Comparable> & a,
+                        int numThreads = thread::hardware_concurrency( ) )
+{
+    WorkStealingPool pool{ numThreads };
+    atomic<int> pending{ 1 };
+
+    pool.submit( [ &a, &pool, &pending ]
+                 { parallelQuicksort( a, 0, a.size( ) - 1, pool, pending ); },
+                 pending );
+    pool.waitUntilDone( pending );
+}
+
+/**
+ * Internal method that stably merges a[leftPos..leftEnd] and
+ * a[rightPos..rightEnd] into tmpArray, starting at tmpPos.
+ * The merge is split recursively around the median of the
+ * larger half, and the pieces are handed to the pool.
+ */
+template <typename Comparable>
+void parallelMerge( vector<Comparable> & a, vector<Comparable> & tmpArray,
+                    int leftPos, int leftEnd, int rightPos, int rightEnd,
+                    int tmpPos, WorkStealingPool & pool )
+{
+    int leftSize = leftEnd - leftPos + 1;
+    int rightSize = rightEnd - rightPos + 1;
+
+    if( leftSize + rightSize < PARALLEL_CUTOFF )
+    {
+        while( leftPos <= leftEnd && rightPos <= rightEnd )
+            if( !( a[ rightPos ] < a[ leftPos ] ) )
+                tmpArray[ tmpPos++ ] = std::move( a[ leftPos++ ] );
+            else
+                tmpArray[ tmpPos++ ] = std::move( a[ rightPos++ ] );
+
+        while( leftPos <= leftEnd )
+            tmpArray[ tmpPos++ ] = std::move( a[ leftPos++ ] );
+        while( rightPos <= rightEnd )
+            tmpArray[ tmpPos++ ] = std::move( a[ rightPos++ ] );
+        return;
+    }
+
+        // Split both halves so that every item in the first pieces
+        // belongs before every item in the second pieces. Ties between
+        // the halves go to the left half, which keeps the merge stable.
+    int leftMid, rightMid;
+    if( leftSize >= rightSize )
+    {
+        leftMid = leftPos + leftSize / 2;
+        rightMid = lower_bound( begin( a ) + rightPos, begin( a ) + rightEnd + 1,
+                                a[ leftMid ] ) - begin( a );
+    }
+    else
+    {
+        rightMid = rightPos + rightSize / 2;
+        leftMid = upper_bound( begin( a ) + leftPos, begin( a ) + leftEnd + 1,
+                               a[ rightMid ] ) - begin( a );
+    }
+
+    int splitPos = tmpPos + ( leftMid - leftPos ) + ( rightMid - rightPos );
+    atomic<int> pending{ 1 };
+
+    pool.submit( [ &, leftMid, rightMid ]
+                 { parallelMerge( a, tmpArray, leftPos, leftMid - 1,
+                                  rightPos, rightMid - 1, tmpPos, pool ); },
+                 pending );
+    parallelMerge( a, tmpArray, leftMid, leftEnd, rightMid, rightEnd, splitPos, pool );
+    pool.waitUntilDone( pending );
+}
+
+/**
+ * Internal parallel mergesort method.
+ * The two halves are sorted concurrently, then merged
+ * in parallel into tmpArray and moved back in parallel.
+ */
+template <typename Comparable>
+void parallelMergeSort( vector<Comparable> & a, vector<Comparable> & tmpArray,
+                        int left, int right, WorkStealingPool & pool )
+{
+    if( left + PARALLEL_CUTOFF > right )
+    {
+        mergeSort( a, tmpArray, left, right );
+        return;
+    }
+
+    int center = ( left + right ) / 2;
+    atomic<int> pending{ 1 };
+
+    pool.submit( [ &, center ]
+                 { parallelMergeSort( a, tmpArray, left, center, pool ); },
+                 pending );
+    parallelMergeSort( a, tmpArray, center + 1, right, pool );
+    pool.waitUntilDone( pending );
+
+    parallelMerge( a, tmpArray, left, center, center + 1, right, left, pool );
+
+        // Move tmpArray back, one block per task
+    for( int from = left; from <= right; from += PARALLEL_CUTOFF )
+    {
+        int to = std::min( from + PARALLEL_CUTOFF - 1, right );
+        ++pending;
+        pool.submit( [ &a, &tmpArray, from, to ]
+                     { std::move( begin( tmpArray ) + from, begin( tmpArray ) + to + 1,
+                                  begin( a ) + from ); },
+                     pending );
+    }
+    pool.waitUntilDone( pending );
+}
+
+/**
+ * Parallel mergesort algorithm (driver).
+ * numThreads is the total number of threads to use.
+ */
+template <typename Comparable>
+void parallelMergeSort( vector<Comparable> & a,
+                        int numThreads = thread::hardware_concurrency( ) )
+{
+    vector<Comparable> tmpArray( a.size( ) );
+    WorkStealingPool pool{ numThreads };
+
+    parallelMergeSort( a, tmpArray, 0, a.size( ) - 1, pool );
+}
+
+/**
+ * Simple recursive sort of Fig 7.13.
+ * Partitions into new smaller, same, and larger vectors.
+ */
+template <typename Comparable>
+void simpleRecursiveSort( vector<Comparable> & items )
+{
+    if( items.size( ) > 1 )
+    {
+        vector<Comparable> smaller;
+        vector<Comparable> same;
+        vector<Comparable> larger;
+        
+        auto chosenItem = items[ items.size( ) / 2 ];
+        
+        for( auto & i : items )
+        {
+            if( i < chosenItem )
+                smaller.push_back( std::move( i ) );
+            else if( chosenItem < i )
+                larger.push_back( std::move( i ) );
+            else
+                same.push_back( std::move( i ) );
+        }
+        
+        simpleRecursiveSort( smaller );     // Recursive call!
+        simpleRecursiveSort( larger );      // Recursive call!
+        
+        std::move( begin( smaller ), end( smaller ), begin( items ) );
+        std::move( begin( same ), end( same ), begin( items ) + smaller.size( ) );
+        std::move( begin( larger ), end( larger ), end( items ) - larger.size( ) );
+
+/*
+        items.clear( );
+        items.insert( end( items ), begin( smaller ), end( smaller ) );
+        items.insert( end( items ), begin( same ), end( same ) );
+        items.insert( end( items ), begin( larger ), end( larger ) );
+*/
+    }
+}
+
+/*
+ * Pattern-defeating quicksort (pdqsort).
+ * An introsort: quicksort that switches to heapsort when it
+ * has made too many bad partitions. On top of that it
+ *   - moves items equal to an earlier pivot out of the way in
+ *     one pass, so runs of duplicates cost linear time;
+ *   - notices when a partition did no swaps and then tries a
+ *     bounded insertion sort, so sorted input is linear;
+ *   - breaks up patterns (organ pipes and the like) that keep
+ *     producing unbalanced partitions, by swapping a few items.
+ * The subarray routines below use half-open ranges [begin,end).
+ */
+
+const int PDQ_INSERTION_CUTOFF = 24;
+const int PDQ_NINTHER_CUTOFF = 128;
+const int PDQ_PARTIAL_INSERTION_LIMIT = 8;
+
+/**
+ * Internal method for pdqsort.
+ * Swaps a[i] and a[j] if they are out of order.
+ */
+template <typename Comparable>
+inline void sort2( vector<Comparable> & a, int i, int j )
+{
+    if( a[ j ] < a[ i ] )
+        std::swap( a[ i ], a[ j ] );
+}
+
+/**
+ * Internal method for pdqsort.
+ * Orders a[i], a[j], and a[k].
+ */
+template <typename Comparable>
+inline void sort3( vector<Comparable> & a, int i, int j, int k )
+{
+    sort2( a, i, j );
+    sort2( a, j, k );
+    sort2( a, i, j );
+}
+
+/**
+ * Internal method for pdqsort.
+ * Insertion sort of a[begin..end) that gives up, returning false,
+ * once more than PDQ_PARTIAL_INSERTION_LIMIT items have been moved.
+ */
+template <typename Comparable>
+bool partialInsertionSort( vector<Comparable> & a, int begin, int end )
+{
+    int moved = 0;
+
+    for( int p = begin + 1; p < end; ++p )
+    {
+        if( a[ p ] < a[ p - 1 ] )
+        {
+            Comparable tmp = std::move( a[ p ] );
+            int j;
+
+            for( j = p; j > begin && tmp < a[ j - 1 ]; --j )
+                a[ j ] = std::move( a[ j - 1 ] );
+            a[ j ] = std::move( tmp );
+            moved += p - j;
+        }
+
+        if( moved > PDQ_PARTIAL_INSERTION_LIMIT )
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Internal method for pdqsort.
+ * Partitions a[begin..end) around the pivot in a[begin]; items
+ * equal to the pivot go to the right. Returns the final position
+ * of the pivot, and sets alreadyPartitioned if no swaps were needed.
+ */
+template <typename Comparable>
+int partitionRight( vector<Comparable> & a, int begin, int end,
+                    bool & alreadyPartitioned )
+{
+    Comparable pivot = std::move( a[ begin ] );
+    int first = begin, last = end;
+
+        // The median-of-3 guarantees an item >= pivot on the right;
+        // an item < pivot on the left exists only if we moved first
+    while( a[ ++first ] < pivot ) { }
+    if( first - 1 == begin )
+        while( first < last && !( a[ --last ] < pivot ) ) { }
+    else
+        while( !( a[ --last ] < pivot ) ) { }
+
+    alreadyPartitioned = first >= last;
+
+    while( first < last )
+    {
+        std::swap( a[ first ], a[ last ] );
+        while( a[ ++first ] < pivot ) { }
+        while( !( a[ --last ] < pivot ) ) { }
+    }
+
+    int pivotPos = first - 1;
+    a[ begin ] = std::move( a[ pivotPos ] );
+    a[ pivotPos ] = std::move( pivot );
+    return pivotPos;
+}
+
+/**
+ * Internal method for pdqsort.
+ * Partitions a[begin..end) around the pivot in a[begin]; items
+ * equal to the pivot go to the left. Used when the pivot equals the
+ * item before begin, in which case nothing in the range is smaller,
+ * and everything left of the returned position needs no more work.
+ */
+template <typename Comparable>
+int partitionLeft( vector<Comparable> & a, int begin, int end )
+{
+    Comparable pivot = std::move( a[ begin ] );
+    int first = begin, last = end;
+
+    while( pivot < a[ --last ] ) { }
+    if( last + 1 == end )
+        while( first < last && !( pivot < a[ ++first ] ) ) { }
+    else
+        while( !( pivot < a[ ++first ] ) ) { }
+
+    while( first < last )
+    {
+        std::swap( a[ first ], a[ last ] );
+        while( pivot < a[ --last ] ) { }
+        while( !( pivot < a[ ++first ] ) ) { }
+    }
+
+    int pivotPos = last;
+    a[ begin ] = std::move( a[ pivotPos ] );
+    a[ pivotPos ] = std::move( pivot );
+    return pivotPos;
+}
+
+/**
+ * Internal pdqsort method that makes recursive calls.
+ * Sorts a[begin..end).
+ * badAllowed is the number of bad partitions left before
+ * switching to heapsort.
+ * leftmost is true if there is no item to the left of begin
+ * in the same partition (otherwise a[begin-1] is a lower bound).
+ */
+template <typename Comparable>
+void pdqsort( vector<Comparable> & a, int begin, int end,
+              int badAllowed, bool leftmost )
+{
+    for( ; ; )
+    {
+        int size = end - begin;
+
+        if( size < PDQ_INSERTION_CUTOFF )
+        {
+            insertionSort( a, begin, end - 1 );
+            return;
+        }
+
+            // Pivot to a[begin]: median of 3, or pseudomedian of 9
+        int half = size / 2;
+        if( size > PDQ_NINTHER_CUTOFF )
+        {
+            sort3( a, begin, begin + half, end - 1 );
+            sort3( a, begin + 1, begin + half - 1, end - 2 );
+            sort3( a, begin + 2, begin + half + 1, end - 3 );
+            sort3( a, begin + half - 1, begin + half, begin + half + 1 );
+            std::swap( a[ begin ], a[ begin + half ] );
+        }
+        else
+            sort3( a, begin + half, begin, end - 1 );
+
+            // Pivot equals an earlier pivot: skip the whole run of equals
+        if( !leftmost && !( a[ begin - 1 ] < a[ begin ] ) )
+        {
+            begin = partitionLeft( a, begin, end ) + 1;
+            continue;
+        }
+
+        bool alreadyPartitioned;
+        int pivotPos = partitionRight( a, begin, end, alreadyPartitioned );
+
+        int leftSize = pivotPos - begin;
+        int rightSize = end - ( pivotPos + 1 );
+
+        if( leftSize < size / 8 || rightSize < size / 8 )
+        {
+            if( --badAllowed == 0 )
+            {
+                heapsort( a, begin, end - 1 );
+                return;
+            }
+
+                // Break up patterns by swapping a few items
+            if( leftSize >= PDQ_INSERTION_CUTOFF )
+            {
+                std::swap( a[ begin ], a[ begin + leftSize / 4 ] );
+                std::swap( a[ pivotPos - 1 ], a[ pivotPos - leftSize / 4 ] );
+                if( leftSize > PDQ_NINTHER_CUTOFF )
+                {
+                    std::swap( a[ begin + 1 ], a[ begin + leftSize / 4 + 1 ] );
+                    std::swap( a[ begin + 2 ], a[ begin + leftSize / 4 + 2 ] );
+                    std::swap( a[ pivotPos - 2 ], a[ pivotPos - leftSize / 4 - 1 ] );
+                    std::swap( a[ pivotPos - 3 ], a[ pivotPos - leftSize / 4 - 2 ] );
+                }
+            }
+            if( rightSize >= PDQ_INSERTION_CUTOFF )
+            {
+                std::swap( a[ pivotPos + 1 ], a[ pivotPos + 1 + rightSize / 4 ] );
+                std::swap( a[ end - 1 ], a[ end - rightSize / 4 ] );
+                if( rightSize > PDQ_NINTHER_CUTOFF )
+                {
+                    std::swap( a[ pivotPos + 2 ], a[ pivotPos + 2 + rightSize / 4 ] );
+                    std::swap( a[ pivotPos + 3 ], a[ pivotPos + 3 + rightSize / 4 ] );
+                    std::swap( a[ end - 2 ], a[ end - 1 - rightSize / 4 ] );
+                    std::swap( a[ end - 3 ], a[ end - 2 - rightSize / 4 ] );
+                }
+            }
+        }
+        else if( alreadyPartitioned
+                 && partialInsertionSort( a, begin, pivotPos )
+                 && partialInsertionSort( a, pivotPos + 1, end ) )
+            return;
+
+        pdqsort( a, begin, pivotPos, badAllowed, leftmost );   // Recurse left,
+        begin = pivotPos + 1;                                  // loop on right
+        leftmost = false;
+    }
+}
+
+/**
+ * Pattern-defeating quicksort algorithm (driver).
+ */
+template <typename Comparable>
+void pdqsort( vector<Comparable> & a )
+{
+    int n = a.size( );
+    int logN = 0;
+
+    while( ( n >> logN ) > 1 )
+        ++logN;
+
+    pdqsort( a, 0, n, logN, true );
+}
+
+/**
+ * General-purpose sort: pattern-defeating quicksort.
+ */
+template <typename Comparable>
+void SORT( vector<Comparable> & items )
+{
+    pdqsort( items );
+}
+
+/**
+ * Internal method for introSelect and multiSelect.
+ * Partitions a[left..right] around the item at pivotPos.
+ * Items equal to the pivot may go to either side, which keeps
+ * the split even when there are many duplicates.
+ * Returns the final position of the pivot.
+ */
+template <typename Comparable>
+int partitionAround( vector<Comparable> & a, int left, int right, int pivotPos )
+{
+    std::swap( a[ pivotPos ], a[ right ] );
+    const Comparable & pivot = a[ right ];
+
+    int i = left - 1, j = right;
+    for( ; ; )
+    {
+        while( a[ ++i ] < pivot ) { }
+        while( j > left && pivot < a[ --j ] ) { }
+        if( i < j )
+            std::swap( a[ i ], a[ j ] );
+        else
+            break;
+    }
+
+    std::swap( a[ i ], a[ right ] );  // Restore pivot
+    return i;
+}
+
+template <typename Comparable>
+int medianOfMedians( vector<Comparable> & a, int left, int right );
+
+/**
+ * Internal selection method that makes recursive calls.
+ * Places the item that belongs at index target in a[target],
+ * with smaller items to its left and larger to its right,
+ * in guaranteed linear time: the pivot is always a median of medians.
+ */
+template <typename Comparable>
+void medianOfMediansSelect( vector<Comparable> & a, int left, int right, int target )
+{
+    while( left + smallSortCutoff<Comparable>( ) <= right )
+    {
+        int i = partitionAround( a, left, right, medianOfMedians( a, left, right ) );
+
+        if( target < i )
+            right = i - 1;
+        else if( target > i )
+            left = i + 1;
+        else
+            return;
+    }
+
+    smallSort( a, left, right );
+}
+
+/**
+ * Internal method for medianOfMediansSelect.
+ * Sorts each group of five in a[left..right], gathers the group
+ * medians at the front of the subarray, and selects their median.
+ * Returns the position of the median of medians, which has at
+ * least 3/10 of the subarray on each side of it.
+ */
+template <typename Comparable>
+int medianOfMedians( vector<Comparable> & a, int left, int right )
+{
+    int numMedians = 0;
+
+    for( int group = left; group + 4 <= right; group += 5 )
+    {
+        insertionSort( a, group, group + 4 );
+        std::swap( a[ group + 2 ], a[ left + numMedians++ ] );
+    }
+
+    int middle = left + numMedians / 2;
+    medianOfMediansSelect( a, left, left + numMedians - 1, middle );
+    return middle;
+}
+
+/**
+ * Internal method for introSelect and multiSelect.
+ * Places a[r-1] for every rank r in ranks[lo..hi-1] (sorted, and
+ * all within left+1..right+1) in a single recursive pass: each
+ * partition sends the ranks on either side of the pivot to the
+ * side that holds them, and subarrays with no ranks are left alone.
+ * Pivots are chosen by median-of-three for the first depthLimit
+ * levels, and by median of medians below that, so the
+ * running time is O(N log m) for m ranks, and O(N) for one rank.
+ */
+template <typename Comparable>
+void multiSelect( vector<Comparable> & a, int left, int right,
+                  const vector<int> & ranks, int lo, int hi, int depthLimit )
+{
+    while( lo < hi )
+    {
+        if( left + smallSortCutoff<Comparable>( ) > right )
+        {
+            smallSort( a, left, right );
+            return;
+        }
+
+        int i = depthLimit-- > 0
+                    ? quicksortPartition( a, left, right )
+                    : partitionAround( a, left, right, medianOfMedians( a, left, right ) );
+
+            // Ranks up to i are left of the pivot, and rank i + 1 is the pivot
+        int mid = std::lower_bound( begin( ranks ) + lo, begin( ranks ) + hi, i + 1 ) - begin( ranks );
+        int next = mid < hi && ranks[ mid ] == i + 1 ? mid + 1 : mid;
+
+        if( mid - lo < hi - next )      // Recurse on the side with fewer ranks
+        {
+            multiSelect( a, left, i - 1, ranks, lo, mid, depthLimit );
+            left = i + 1;
+            lo = next;
+        }
+        else
+        {
+            multiSelect( a, i + 1, right, ranks, next, hi, depthLimit );
+            right = i - 1;
+            hi = mid;
+        }
+    }
+}
+
+/**
+ * Return 2 floor(log2 N), the number of median-of-three partitions
+ * allowed before introSelect and multiSelect change pivot rules.
+ */
+inline int selectDepthLimit( int n )
+{
+    int logN = 0;
+
+    while( ( n >> logN ) > 1 )
+        ++logN;
+    return 2 * logN;
+}
+
+/**
+ * Selection in guaranteed linear time (introselect).
+ * Places the kth smallest item in a[k-1], with smaller items
+ * before it and larger items after it.
+ * a is an array of Comparable items.
+ * k is the desired rank (1 is minimum) in the entire array.
+ */
+template <typename Comparable>
+void introSelect( vector<Comparable> & a, int k )
+{
+    vector<int> ranks{ k };
+    multiSelect( a, 0, a.size( ) - 1, ranks, 0, 1, selectDepthLimit( a.size( ) ) );
+}
+
+/**
+ * Select several ranks at once, e.g. the p50, p90, p99, and p999
+ * of a latency vector.
+ * Places the rth smallest item in a[r-1] for every r in ranks.
+ * ranks may be in any order and may repeat; each is 1..a.size( ).
+ */
+template <typename Comparable>
+void multiSelect( vector<Comparable> & a, const vector<int> & ranks )
+{
+    vector<int> sorted = ranks;
+    std::sort( begin( sorted ), end( sorted ) );
+    sorted.erase( std::unique( begin( sorted ), end( sorted ) ), end( sorted ) );
+
+    multiSelect( a, 0, a.size( ) - 1, sorted, 0, sorted.size( ),
+                 selectDepthLimit( a.size( ) ) );
+}
+
+/**
+ * Partial sort.
+ * Places the k smallest items, in sorted order, in a[0..k-1];
+ * the rest of the array is left in no particular order.
+ * Takes O(N + k log k): a linear-time selection of rank k,
+ * then a pdqsort of the first k items.
+ */
+template <typename Comparable>
+void partialSort( vector<Comparable> & a, int k )
+{
+    k = std::min<int>( k, a.size( ) );
+    if( k <= 0 )
+        return;
+
+    introSelect( a, k );
+    pdqsort( a, 0, k, selectDepthLimit( k ) / 2, true );
+}
+
+/**
+ * Internal method for bottomUpHeapsort.
+ * Percolates tmp down from hole i in the binary heap a[0..n-1]
+ * (Floyd's method): the hole first follows the larger child all
+ * the way to a leaf, one comparison per level and none against tmp,
+ * and tmp then climbs back up from there. Since the item that is
+ * moved into the hole usually belongs near a leaf, the climb is
+ * short, and the sift costs about half the comparisons of percDown.
+ */
+template <typename Comparable>
+void percDownBottomUp( vector<Comparable> & a, int i, int n, Comparable tmp )
+{
+    int top = i;
+
+    for( int child; ( child = leftChild( i ) ) < n; i = child )
+    {
+        if( child != n - 1 && a[ child ] < a[ child + 1 ] )
+            ++child;
+        a[ i ] = std::move( a[ child ] );
+    }
+
+    for( int parent; i > top && a[ parent = ( i - 1 ) / 2 ] < tmp; i = parent )
+        a[ i ] = std::move( a[ parent ] );
+    a[ i ] = std::move( tmp );
+}
+
+/**
+ * Bottom-up heapsort.
+ * Same heap as heapsort, with each percolation done by
+ * percDownBottomUp, so it needs about N log N comparisons
+ * instead of 2 N log N.
+ */
+template <typename Comparable>
+void bottomUpHeapsort( vector<Comparable> & a )
+{
+    int n = a.size( );
+
+    for( int i = n / 2 - 1; i >= 0; --i )          /* buildHeap */
+        percDownBottomUp( a, i, n, std::move( a[ i ] ) );
+    for( int j = n - 1; j > 0; --j )
+    {
+        Comparable tmp = std::move( a[ j ] );       /* deleteMax */
+        a[ j ] = std::move( a[ 0 ] );
+        percDownBottomUp( a, 0, j, std::move( tmp ) );
+    }
+}
+
+/**
+ * Size in bytes of a cache line.
+ */
+const int CACHE_LINE = 64;
+
+/**
+ * Internal method for dAryHeapsort.
+ * Percolates down from position i of the D-ary heap that
+ * occupies a[base..base+n-1]; the children of heap node i
+ * are heap nodes D*i+1 through D*i+D.
+ */
+template <int D, typename Comparable>
+void dAryPercDown( vector<Comparable> & a, int base, int i, int n )
+{
+    Comparable tmp = std::move( a[ base + i ] );
+
+    while( D * i + 1 < n )
+    {
+        int first = D * i + 1;
+        int last = std::min( first + D, n );
+        int child = first;
+
+        for( int c = first + 1; c < last; ++c )
+            if( a[ base + child ] < a[ base + c ] )
+                child = c;
+        if( !( tmp < a[ base + child ] ) )
+            break;
+        a[ base + i ] = std::move( a[ base + child ] );
+        i = child;
+    }
+    a[ base + i ] = std::move( tmp );
+}
+
+/**
+ * Internal method for dAryHeapsort.
+ * Returns the index in a at which a D-ary heap should start so
+ * that every group of D siblings begins on a multiple of D items
+ * from a CACHE_LINE boundary, and so never straddles two lines.
+ * Returns 0 when D items do not divide a cache line, or a is
+ * not aligned to its item size.
+ */
+template <int D, typename Comparable>
+int cacheAlignedBase( const vector<Comparable> & a )
+{
+    const int GROUP = D * sizeof( Comparable );
+
+    if( a.empty( ) || CACHE_LINE % GROUP != 0 )
+        return 0;
+
+    uintptr_t address = reinterpret_cast<uintptr_t>( &a[ 0 ] );
+    if( address % sizeof( Comparable ) != 0 )
+        return 0;
+
+        // Heap node 1, the first child of the root, must start a group
+    int phase = address % GROUP / sizeof( Comparable );
+    return std::min<int>( ( 2 * D - phase - 1 ) % D, a.size( ) );
+}
+
+/**
+ * Heapsort with a D-ary heap (D = 4 or 8 is typical).
+ * The heap is shallower than a binary heap, and the D children
+ * of a node are adjacent, so each level of a percolation reads
+ * one cache line when the heap is placed by cacheAlignedBase.
+ * The few items in front of that base are the smallest in a,
+ * found with introSelect, and are sorted separately.
+ */
+template <int D, typename Comparable>
+void dAryHeapsort( vector<Comparable> & a )
+{
+    static_assert( D >= 2, "a heap needs at least two children per node" );
+
+    int base = cacheAlignedBase<D>( a );
+    int n = a.size( ) - base;
+
+    if( base > 0 )
+    {
+        introSelect( a, base );
+        insertionSort( a, 0, base - 1 );
+    }
+    if( n < 2 )
+        return;
+
+    for( int i = ( n - 2 ) / D; i >= 0; --i )      /* buildHeap */
+        dAryPercDown<D>( a, base, i, n );
+    for( int j = n - 1; j > 0; --j )
+    {
+        std::swap( a[ base ], a[ base + j ] );      /* deleteMax */
+        dAryPercDown<D>( a, base, 0, j );
+    }
+}
+
+/*
+ * LSD radix sort for items keyed by integers or floating-point
+ * numbers. Each key is mapped to an unsigned integer with the same
+ * order (radixBits), and the items are then distributed by digits
+ * of that integer, least significant digit first. The sort is
+ * stable, so it also orders records by a key member.
+ */
+
+/**
+ * Internal method for radixSort.
+ * Map an integral key to an unsigned integer with the same order:
+ * flipping the sign bit moves negative numbers below positive ones.
+ */
+template <typename Key>
+typename enable_if<is_integral<Key>::value, typename make_unsigned<Key>::type>::type
+radixBits( Key key )
+{
+    typedef typename make_unsigned<Key>::type Bits;
+
+    Bits bits = static_cast<Bits>( key );
+    if( is_signed<Key>::value )
+        bits ^= static_cast<Bits>( Bits( 1 ) << ( sizeof( Key ) * 8 - 1 ) );
+    return bits;
+}
+
+/**
+ * Internal method for radixSort.
+ * Map a float to an unsigned integer with the same order: negative
+ * numbers have all bits flipped (so larger magnitudes come first),
+ * and positive numbers have the sign bit set.
+ */
+inline uint32_t radixBits( float key )
+{
+    uint32_t bits;
+    memcpy( &bits, &key, sizeof( bits ) );
+    return ( bits & 0x80000000u ) ? ~bits : bits | 0x80000000u;
+}
+
+inline uint64_t radixBits( double key )
+{
+    uint64_t bits;
+    memcpy( &bits, &key, sizeof( bits ) );
+    return ( bits & 0x8000000000000000ull ) ? ~bits : bits | 0x8000000000000000ull;
+}
+
+/**
+ * Key extractor that returns the item itself.
+ */
+struct IdentityKey
+{
+    template <typename Key>
+    const Key & operator( ) ( const Key & key ) const
+      { return key; }
+};
+
+/**
+ * Radix sort of a by keyOf( item ), which must return an integral
+ * (but not bool), float, or double key.
+ * digitBits is the number of key bits handled by each pass (8, 11,
+ * and 16 are typical; larger values are cut to 16, the most whose
+ * counts stay small); 0 or less picks 8 bits for keys of up to 16 bits,
+ * 11 bits for 32-bit keys, and 16 bits for 64-bit keys on large arrays.
+ * The counts for every pass are gathered in a single scan, passes in
+ * which all keys share the same digit are skipped, and the items move
+ * back and forth between a and one buffer allocated up front.
+ */
+template <typename Comparable, typename KeyExtractor>
+void radixSort( vector<Comparable> & a, KeyExtractor keyOf, int digitBits = 0 )
+{
+    typedef typename decay<decltype( keyOf( a[ 0 ] ) )>::type Key;
+    static_assert( ( is_integral<Key>::value && !is_same<Key, bool>::value )
+                   || is_same<Key, float>::value || is_same<Key, double>::value,
+                   "radixSort needs an integral (not bool), float, or double key" );
+    typedef decltype( radixBits( keyOf( a[ 0 ] ) ) ) Bits;
+    const int KEY_BITS = sizeof( Bits ) * 8;
+    const int MAX_DIGIT_BITS = 16;
+
+    int n = a.size( );
+    if( n < 2 )
+        return;
+
+    if( digitBits <= 0 )
+        digitBits = KEY_BITS <= 16 ? 8 : KEY_BITS <= 32 ? 11 : n >= ( 1 << 20 ) ? 16 : 11;
+    digitBits = std::min( digitBits, std::min( KEY_BITS, MAX_DIGIT_BITS ) );
+
+    const int BUCKETS = 1 << digitBits;
+    const Bits MASK = BUCKETS - 1;
+    int numPasses = ( KEY_BITS + digitBits - 1 ) / digitBits;
+
+        // One scan counts the digits for all passes
+    vector<int> count( numPasses * BUCKETS );
+    for( int i = 0; i < n; ++i )
+    {
+        Bits bits = radixBits( keyOf( a[ i ] ) );
+        for( int pass = 0; pass < numPasses; ++pass )
+            ++count[ pass * BUCKETS + ( ( bits >> ( pass * digitBits ) ) & MASK ) ];
+    }
+
+    Bits firstBits = radixBits( keyOf( a[ 0 ] ) );
+    vector<Comparable> buffer;
+    vector<Comparable> *in = &a;
+    vector<Comparable> *out = &buffer;
+
+    for( int pass = 0; pass < numPasses; ++pass )
+    {
+        int shift = pass * digitBits;
+        int *offset = &count[ pass * BUCKETS ];
+
+            // Skip the pass if every key has the same digit
+        if( offset[ ( firstBits >> shift ) & MASK ] == n )
+            continue;
+
+        for( int b = 0, sum = 0; b < BUCKETS; ++b )    // Exclusive prefix sums
+        {
+            int thisCount = offset[ b ];
+            offset[ b ] = sum;
+            sum += thisCount;
+        }
+
+        if( buffer.empty( ) )
+            buffer.resize( n );
+
+        for( int i = 0; i < n; ++i )
+        {
+            Bits bits = radixBits( keyOf( ( *in )[ i ] ) );
+            ( *out )[ offset[ ( bits >> shift ) & MASK ]++ ] = std::move( ( *in )[ i ] );
+        }
+
+            // swap in and out roles
+        std::swap( in, out );
+    }
+
+        // After an odd number of passes, the items are in buffer
+    if( in != &a )
+        std::move( begin( buffer ), end( buffer ), begin( a ) );
+}
+
+/**
+ * Radix sort of integral (but not bool), float, or double items.
+ */
+template <typename Comparable>
+void radixSort( vector<Comparable> & a )
+{
+    radixSort( a, IdentityKey{ } );
+}
+
+/*
+ * Sorting large records by moving indices instead of the records.
+ * sortIndices returns the permutation that would sort the items by
+ * a key, applyPermutation then moves each record at most once, and
+ * sortByKey does both.
+ */
+
+/**
+ * Internal method for sortIndices.
+ * A key paired with the index of its item; ties on the key
+ * are broken by index, so sorting these is stable.
+ */
+template <typename Key>
+struct KeyedIndex
+{
+    Key key;
+    int index;
+
+    bool operator< ( const KeyedIndex & rhs ) const
+      { return key < rhs.key || ( !( rhs.key < key ) && index < rhs.index ); }
+};
+
+/**
+ * Internal method for sortIndices, for keys of up to 32 bits.
+ * Each item becomes one 64-bit word, the key's radixBits above
+ * its index, so the sort moves 8 bytes per item and compares
+ * them as plain integers. The words start in index order, so a
+ * stable radix sort on the upper 32 bits alone sorts them fully.
+ */
+template <typename Comparable, typename KeyExtractor>
+vector<int> sortIndices( const vector<Comparable> & items, KeyExtractor keyOf, true_type )
+{
+    int n = items.size( );
+    vector<uint64_t> packed( n );
+
+    for( int i = 0; i < n; ++i )
+        packed[ i ] = uint64_t( radixBits( keyOf( items[ i ] ) ) ) << 32 | uint32_t( i );
+    radixSort( packed, [ ] ( uint64_t word ) { return uint32_t( word >> 32 ); } );
+
+    vector<int> order( n );
+    for( int i = 0; i < n; ++i )
+        order[ i ] = int( packed[ i ] & 0xffffffffu );
+    return order;
+}
+
+/**
+ * Internal method for sortIndices, for all other keys.
+ * Sorts (key, index) pairs with SORT.
+ */
+template <typename Comparable, typename KeyExtractor>
+vector<int> sortIndices( const vector<Comparable> & items, KeyExtractor keyOf, false_type )
+{
+    typedef typename decay<decltype( keyOf( items[ 0 ] ) )>::type Key;
+    int n = items.size( );
+    vector<KeyedIndex<Key>> pairs;
+
+    pairs.reserve( n );
+    for( int i = 0; i < n; ++i )
+        pairs.push_back( KeyedIndex<Key>{ keyOf( items[ i ] ), i } );
+    SORT( pairs );
+
+    vector<int> order( n );
+    for( int i = 0; i < n; ++i )
+        order[ i ] = pairs[ i ].index;
+    return order;
+}
+
+/**
+ * Return the permutation that stably sorts items by keyOf:
+ * order[ i ] is the index of the item that belongs at position i.
+ * items is not changed. Arithmetic keys of up to 32 bits are
+ * packed with their indices into 64-bit words; other keys need
+ * only operator<.
+ */
+template <typename Comparable, typename KeyExtractor>
+vector<int> sortIndices( const vector<Comparable> & items, KeyExtractor keyOf )
+{
+    typedef typename decay<decltype( keyOf( items[ 0 ] ) )>::type Key;
+
+    return sortIndices( items, keyOf,
+                        integral_constant<bool, is_arithmetic<Key>::value
+                                                && !is_same<Key, bool>::value
+                                                && sizeof( Key ) <= 4>{ } );
+}
+
+/**
+ * Rearrange a so that the new a[ i ] is the old a[ order[ i ] ].
+ * Follows each cycle of the permutation, holding one item aside,
+ * so every item is moved exactly once (plus one extra move per
+ * cycle) and only a bit per item is allocated.
+ * order must be a permutation of 0..a.size( )-1.
+ */
+template <typename Comparable>
+void applyPermutation( vector<Comparable> & a, const vector<int> & order )
+{
+    int n = a.size( );
+    vector<bool> placed( n, false );
+
+    for( int start = 0; start < n; ++start )
+    {
+        if( placed[ start ] || order[ start ] == start )
+            continue;
+
+        Comparable tmp = std::move( a[ start ] );
+        int hole = start;
+
+        for( int from; ( from = order[ hole ] ) != start; hole = from )
+        {
+            a[ hole ] = std::move( a[ from ] );
+            placed[ hole ] = true;
+        }
+        a[ hole ] = std::move( tmp );
+        placed[ hole ] = true;
+    }
+}
+
+/**
+ * Stably sort a by keyOf, moving each item once.
+ * Meant for large records: the sort itself runs on
+ * indices (see sortIndices), and the records are then
+ * moved into place by applyPermutation.
+ */
+template <typename Comparable, typename KeyExtractor>
+void sortByKey( vector<Comparable> & a, KeyExtractor keyOf )
+{
+    applyPermutation( a, sortIndices( a, keyOf ) );
+}
+
 /*
  * This is the more public version of insertion sort.
  * It requires a pair of iterators and a comparison
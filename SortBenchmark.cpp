@@ -0,0 +1,449 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include "Sort.h"
+#include "UniformRandom.h"
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+using namespace std;
+
+/*
+ * Timing harness for the routines in Sort.h.
+ * Usage: SortBenchmark [experiment] [N]
+ *   scaling    speedup of parallelQuicksort and parallelMergeSort
+ *              at 1, 2, 4, ... threads, up to the core count
+ *   partition  cycles per item of hoarePartition and blockPartition
+ *   network    cycles per item of insertionSort and networkSort
+ *              on arrays of 8, 16, and 32 keys
+ *   radix      seconds for radixSort, with each digit width,
+ *              against quicksort and SORT
+ *   mergesort  seconds for mergeSort and mergeSortBottomUp, and for
+ *              sorting many small arrays with and without an arena
+ *   timsort    seconds for timSort against the mergesorts on random,
+ *              batched, and nearly sorted input
+ *   select     seconds to find p50, p90, p99, and p999 with one
+ *              multiSelect, four quickSelects, and SORT, and the
+ *              top 100 with partialSort
+ *   heapsort   seconds for heapsort, bottomUpHeapsort, and 4- and
+ *              8-ary dAryHeapsort at N = 10^6, 10^7, ... up to N
+ *   records    seconds for SORT and sortByKey on 200-byte records
+ */
+
+/**
+ * Return the wall-clock seconds taken by a single call of f.
+ */
+template <typename Function>
+double timeIt( Function f )
+{
+    auto start = chrono::steady_clock::now( );
+    f( );
+    auto end = chrono::steady_clock::now( );
+    return chrono::duration<double>( end - start ).count( );
+}
+
+/**
+ * Return a timestamp in CPU cycles where the processor
+ * provides a counter, and in nanoseconds otherwise.
+ */
+inline unsigned long long cycleCount( )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+    return __rdtsc( );
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(
+               chrono::steady_clock::now( ).time_since_epoch( ) ).count( );
+#endif
+}
+
+vector<int> randomInts( int n )
+{
+    UniformRandom r{ 12345 };
+    vector<int> v( n );
+
+    for( int & x : v )
+        x = r.nextInt( );
+    return v;
+}
+
+void checkSorted( const vector<int> & a, const string & name )
+{
+    for( int i = 1; i < a.size( ); ++i )
+        if( a[ i ] < a[ i - 1 ] )
+        {
+            cout << name << ": OOPS!! out of order at " << i << endl;
+            return;
+        }
+}
+
+/**
+ * Report the speedup of the parallel sorts over their
+ * one-thread runs, doubling the thread count each time.
+ */
+void scalingExperiment( int n )
+{
+    int maxThreads = thread::hardware_concurrency( );
+    if( maxThreads < 1 )
+        maxThreads = 1;
+
+    const vector<int> original = randomInts( n );
+    double quickBase = 0, mergeBase = 0;
+
+    cout << "N = " << n << ", " << maxThreads << " hardware threads" << endl;
+    cout << "threads   quicksort (s)  speedup   mergeSort (s)  speedup" << endl;
+
+    for( int threads = 1; ; threads *= 2 )
+    {
+        if( threads > maxThreads )
+            threads = maxThreads;
+
+        vector<int> a = original;
+        double quickTime = timeIt( [ & ] { parallelQuicksort( a, threads ); } );
+        checkSorted( a, "parallelQuicksort" );
+
+        a = original;
+        double mergeTime = timeIt( [ & ] { parallelMergeSort( a, threads ); } );
+        checkSorted( a, "parallelMergeSort" );
+
+        if( threads == 1 )
+        {
+            quickBase = quickTime;
+            mergeBase = mergeTime;
+        }
+
+        cout << fixed << setprecision( 3 )
+             << setw( 7 ) << threads
+             << setw( 16 ) << quickTime << setw( 9 ) << quickBase / quickTime
+             << setw( 16 ) << mergeTime << setw( 9 ) << mergeBase / mergeTime << endl;
+
+        if( threads == maxThreads )
+            break;
+    }
+}
+
+/**
+ * Return the fewest cycles per item taken by partition over
+ * several fresh copies of input.
+ */
+template <typename Comparable, typename Partition>
+double cyclesPerItem( const vector<Comparable> & input, Partition partition )
+{
+    double best = 1e30;
+
+    for( int trial = 0; trial < 5; ++trial )
+    {
+        vector<Comparable> a = input;
+        unsigned long long start = cycleCount( );
+        partition( a, 0, a.size( ) - 1 );
+        unsigned long long end = cycleCount( );
+        best = std::min( best, double( end - start ) / a.size( ) );
+    }
+
+    return best;
+}
+
+template <typename Comparable>
+void comparePartitions( const vector<Comparable> & input, const string & name )
+{
+    double hoare = cyclesPerItem( input, hoarePartition<Comparable> );
+    double block = cyclesPerItem( input, blockPartition<Comparable> );
+
+    cout << fixed << setprecision( 2 )
+         << setw( 8 ) << name << setw( 12 ) << hoare << setw( 12 ) << block
+         << setw( 12 ) << hoare / block << endl;
+}
+
+/**
+ * Report cycles per item of one partitioning pass with the
+ * branchy and the branchless partition, on random keys.
+ */
+void partitionExperiment( int n )
+{
+    vector<int> ints = randomInts( n );
+    vector<double> doubles( n );
+    UniformRandom r{ 54321 };
+    for( double & x : doubles )
+        x = r.nextDouble( );
+
+    cout << "N = " << n << ", cycles per item" << endl;
+    cout << "    type       hoare       block     speedup" << endl;
+    comparePartitions( ints, "int" );
+    comparePartitions( doubles, "double" );
+}
+
+/**
+ * Report cycles per item for sorting consecutive small
+ * chunks of n random keys, by insertion sort and by network.
+ */
+template <typename Number>
+void compareSmallSorts( int n, const string & name )
+{
+    UniformRandom r{ 777 };
+    vector<Number> input( n );
+    for( Number & x : input )
+        x = static_cast<Number>( r.nextInt( ) );
+
+    for( int size = 8; size <= NETWORK_CUTOFF; size *= 2 )
+    {
+        vector<Number> a = input;
+        unsigned long long start = cycleCount( );
+        for( int left = 0; left + size <= n; left += size )
+            insertionSort( a, left, left + size - 1 );
+        double insertion = double( cycleCount( ) - start ) / n;
+
+        a = input;
+        start = cycleCount( );
+        for( int left = 0; left + size <= n; left += size )
+            networkSort( &a[ left ], size );
+        double network = double( cycleCount( ) - start ) / n;
+
+        cout << fixed << setprecision( 2 )
+             << setw( 10 ) << name << setw( 6 ) << size << setw( 12 ) << insertion
+             << setw( 12 ) << network << setw( 12 ) << insertion / network << endl;
+    }
+}
+
+void networkExperiment( int n )
+{
+    cout << "N = " << n << ", cycles per item" << endl;
+    cout << "      type  size   insertion     network     speedup" << endl;
+    compareSmallSorts<int>( n, "int" );
+    compareSmallSorts<long long>( n, "long long" );
+    compareSmallSorts<float>( n, "float" );
+    compareSmallSorts<double>( n, "double" );
+}
+
+template <typename Number>
+void compareRadixSort( const vector<Number> & input, const string & name )
+{
+    cout << setw( 10 ) << name << fixed << setprecision( 3 );
+
+    for( int digitBits = 8; digitBits <= 16; digitBits += digitBits == 8 ? 3 : 5 )
+    {
+        vector<Number> a = input;
+        cout << setw( 10 ) << timeIt( [ & ] { radixSort( a, IdentityKey{ }, digitBits ); } );
+    }
+
+    vector<Number> a = input;
+    cout << setw( 11 ) << timeIt( [ & ] { quicksort( a ); } );
+    a = input;
+    cout << setw( 10 ) << timeIt( [ & ] { SORT( a ); } ) << endl;
+}
+
+void radixExperiment( int n )
+{
+    UniformRandom r{ 2024 };
+    vector<unsigned int> u32( n );
+    vector<unsigned long long> u64( n );
+    vector<double> doubles( n );
+
+    for( int i = 0; i < n; ++i )
+    {
+        u32[ i ] = r.nextInt( );
+        u64[ i ] = ( static_cast<unsigned long long>( r.nextInt( ) ) << 32 ) ^ u32[ i ];
+        doubles[ i ] = ( r.nextDouble( ) - 0.5 ) * 1e9;
+    }
+
+    cout << "N = " << n << ", seconds" << endl;
+    cout << "      type    8 bits   11 bits   16 bits  quicksort      SORT" << endl;
+    compareRadixSort( u32, "uint32" );
+    compareRadixSort( u64, "uint64" );
+    compareRadixSort( doubles, "double" );
+}
+
+void mergeSortExperiment( int n )
+{
+    vector<int> random = randomInts( n );
+    vector<int> batches( n );
+    for( int i = 0; i < n; ++i )
+        batches[ i ] = i % ( n / 16 + 1 );    // 16 sorted batches
+
+    cout << "N = " << n << ", seconds" << endl;
+    cout << "     input   mergeSort   bottomUp" << endl;
+    for( int kind = 0; kind < 2; ++kind )
+    {
+        const vector<int> & input = kind == 0 ? random : batches;
+        vector<int> a = input;
+        double topDown = timeIt( [ & ] { mergeSort( a ); } );
+        a = input;
+        double bottomUp = timeIt( [ & ] { mergeSortBottomUp( a ); } );
+        cout << fixed << setprecision( 3 ) << setw( 10 ) << ( kind == 0 ? "random" : "batches" )
+             << setw( 12 ) << topDown << setw( 11 ) << bottomUp << endl;
+    }
+
+    const int SMALL = 1000;
+    vector<vector<int>> arrays( n / SMALL, vector<int>( SMALL ) );
+    for( int i = 0; i < arrays.size( ); ++i )
+        std::copy( begin( random ) + i * SMALL, begin( random ) + ( i + 1 ) * SMALL,
+                   begin( arrays[ i ] ) );
+
+    vector<vector<int>> copies = arrays;
+    double fresh = timeIt( [ & ] { for( vector<int> & v : copies ) mergeSort( v ); } );
+    copies = arrays;
+    MergeSortArena<int> arena;
+    double reused = timeIt( [ & ] { arena.sortAll( copies ); } );
+    cout << arrays.size( ) << " arrays of " << SMALL << ": mergeSort " << fresh
+         << ", MergeSortArena " << reused << endl;
+}
+
+void timSortExperiment( int n )
+{
+    UniformRandom r{ 99 };
+    vector<vector<int>> inputs( 3, vector<int>( n ) );
+    const char *names[ ] = { "random", "batches", "nearly sorted" };
+
+    inputs[ 0 ] = randomInts( n );
+    for( int i = 0; i < n; ++i )
+        inputs[ 1 ][ i ] = i % ( n / 16 + 1 );
+    for( int i = 0; i < n; ++i )
+        inputs[ 2 ][ i ] = i;
+    for( int i = 0; i < n / 1000; ++i )
+        swap( inputs[ 2 ][ r.nextInt( 0, n - 1 ) ], inputs[ 2 ][ r.nextInt( 0, n - 1 ) ] );
+
+    cout << "N = " << n << ", seconds" << endl;
+    cout << "          input     timSort   bottomUp  mergeSort" << endl;
+    for( int kind = 0; kind < 3; ++kind )
+    {
+        vector<int> a = inputs[ kind ];
+        double tim = timeIt( [ & ] { timSort( a ); } );
+        checkSorted( a, "timSort" );
+        a = inputs[ kind ];
+        double bottomUp = timeIt( [ & ] { mergeSortBottomUp( a ); } );
+        a = inputs[ kind ];
+        double topDown = timeIt( [ & ] { mergeSort( a ); } );
+
+        cout << fixed << setprecision( 3 ) << setw( 15 ) << names[ kind ]
+             << setw( 12 ) << tim << setw( 11 ) << bottomUp << setw( 11 ) << topDown << endl;
+    }
+}
+
+void selectExperiment( int n )
+{
+    const vector<int> input = randomInts( n );
+    vector<int> ranks{ n / 2, n * 9 / 10, n * 99 / 100, n * 999 / 1000 };
+
+    vector<int> a = input;
+    double multi = timeIt( [ & ] { multiSelect( a, ranks ); } );
+    vector<int> percentiles;
+    for( int r : ranks )
+        percentiles.push_back( a[ r - 1 ] );
+
+    double quick = 0;
+    for( int r : ranks )
+    {
+        a = input;
+        quick += timeIt( [ & ] { quickSelect( a, r ); } );
+    }
+
+    a = input;
+    double sorted = timeIt( [ & ] { SORT( a ); } );
+    for( int i = 0; i < ranks.size( ); ++i )
+        if( a[ ranks[ i ] - 1 ] != percentiles[ i ] )
+            cout << "multiSelect: OOPS!! wrong percentile" << endl;
+
+    a = input;
+    double top = timeIt( [ & ] { partialSort( a, 100 ); } );
+
+    cout << "N = " << n << ", seconds" << endl;
+    cout << fixed << setprecision( 3 )
+         << "multiSelect " << multi << ", 4 quickSelects " << quick
+         << ", SORT " << sorted << ", partialSort top 100 " << top << endl;
+}
+
+void heapsortExperiment( int n )
+{
+    cout << "seconds" << endl;
+    cout << "           N    heapsort    bottomUp     4-ary     8-ary" << endl;
+
+    for( long long size = 1000000; size <= n; size *= 10 )
+    {
+        const vector<int> input = randomInts( size );
+        vector<int> a = input;
+        double binary = timeIt( [ & ] { heapsort( a ); } );
+        a = input;
+        double bottomUp = timeIt( [ & ] { bottomUpHeapsort( a ); } );
+        checkSorted( a, "bottomUpHeapsort" );
+        a = input;
+        double fourWay = timeIt( [ & ] { dAryHeapsort<4>( a ); } );
+        checkSorted( a, "dAryHeapsort<4>" );
+        a = input;
+        double eightWay = timeIt( [ & ] { dAryHeapsort<8>( a ); } );
+        checkSorted( a, "dAryHeapsort<8>" );
+
+        cout << fixed << setprecision( 3 ) << setw( 12 ) << size
+             << setw( 12 ) << binary << setw( 12 ) << bottomUp
+             << setw( 10 ) << fourWay << setw( 10 ) << eightWay << endl;
+    }
+}
+
+/**
+ * A 200-byte record with an int key, for the records experiment.
+ */
+struct WideRecord
+{
+    int key;
+    char payload[ 196 ];
+
+    bool operator< ( const WideRecord & rhs ) const
+      { return key < rhs.key; }
+};
+
+void recordsExperiment( int n )
+{
+    vector<int> keys = randomInts( n );
+    vector<WideRecord> input( n );
+    for( int i = 0; i < n; ++i )
+        input[ i ].key = keys[ i ];
+
+    vector<WideRecord> a = input;
+    double sorted = timeIt( [ & ] { SORT( a ); } );
+    a = input;
+    double indices = timeIt( [ & ] { sortIndices( a, [ ] ( const WideRecord & rec ) { return rec.key; } ); } );
+    double byKey = timeIt( [ & ] { sortByKey( a, [ ] ( const WideRecord & rec ) { return rec.key; } ); } );
+    for( int i = 1; i < n; ++i )
+        if( a[ i ].key < a[ i - 1 ].key )
+        {
+            cout << "sortByKey: OOPS!! out of order at " << i << endl;
+            break;
+        }
+
+    cout << "N = " << n << " records of " << sizeof( WideRecord ) << " bytes, seconds" << endl;
+    cout << fixed << setprecision( 3 ) << "SORT " << sorted << ", sortIndices "
+         << indices << ", sortByKey " << byKey << endl;
+}
+
+int main( int argc, char *argv[ ] )
+{
+    string experiment = argc > 1 ? argv[ 1 ] : "scaling";
+    int n = argc > 2 ? atoi( argv[ 2 ] ) : 10000000;
+
+    if( experiment == "scaling" )
+        scalingExperiment( n );
+    else if( experiment == "partition" )
+        partitionExperiment( n );
+    else if( experiment == "network" )
+        networkExperiment( n );
+    else if( experiment == "radix" )
+        radixExperiment( n );
+    else if( experiment == "mergesort" )
+        mergeSortExperiment( n );
+    else if( experiment == "timsort" )
+        timSortExperiment( n );
+    else if( experiment == "select" )
+        selectExperiment( n );
+    else if( experiment == "heapsort" )
+        heapsortExperiment( n );
+    else if( experiment == "records" )
+        recordsExperiment( n );
+    else
+    {
+        cerr << "Unknown experiment " << experiment << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,317 @@
+#ifndef SORTING_NETWORK_H
+#define SORTING_NETWORK_H
+
+/**
+ * Sorting networks for small arrays of primitive keys:
+ * 32- and 64-bit signed integers, float, and double.
+ * networkSort( a, n ) sorts up to NETWORK_CUTOFF items by padding
+ * them to 8, 16, or 32 and running a bitonic network. The network
+ * uses AVX2 compare/blend/permute instructions when the processor has
+ * them (checked once, at run time), and a branch-free scalar
+ * version of the same network otherwise.
+ * Every comparator sets lo and hi from one comparison, b < a, so it
+ * exchanges its pair or leaves it alone: keys that compare equal but
+ * differ, like -0.0 and +0.0, are kept rather than duplicated.
+ * NaNs are not supported.
+ */
+
+#include <limits>
+#include <type_traits>
+#include <algorithm>
+using namespace std;
+
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) \
+    && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define SORTING_NETWORK_AVX2 1
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__( ( target( "avx2" ) ) )
+#endif
+
+/**
+ * Largest array that networkSort will accept.
+ */
+const int NETWORK_CUTOFF = 32;
+
+/**
+ * True for the key types that networkSort handles.
+ */
+template <typename T>
+struct isNetworkSortable
+  : integral_constant<bool,
+        ( is_integral<T>::value && is_signed<T>::value
+              && ( sizeof( T ) == 4 || sizeof( T ) == 8 ) )
+        || is_same<T, float>::value || is_same<T, double>::value>
+{
+};
+
+/**
+ * Value that sorts after (or equal to) every key of type T;
+ * used to pad arrays up to the network size.
+ */
+template <typename T>
+T networkPadding( )
+{
+    return numeric_limits<T>::has_infinity ? numeric_limits<T>::infinity( )
+                                           : numeric_limits<T>::max( );
+}
+
+/**
+ * Bitonic sorting network on v[0..size-1], size a power of 2.
+ * Comparators are written as selects, so the compiler
+ * emits no data-dependent branches.
+ */
+template <typename T>
+void bitonicNetwork( T *v, int size )
+{
+    for( int k = 2; k <= size; k *= 2 )
+        for( int j = k / 2; j > 0; j /= 2 )
+            for( int i = 0; i < size; ++i )
+            {
+                int partner = i ^ j;
+                if( partner > i )
+                {
+                    T a = v[ i ], b = v[ partner ];
+                    T lo = b < a ? b : a;
+                    T hi = b < a ? a : b;
+                    bool ascending = ( i & k ) == 0;
+                    v[ i ] = ascending ? lo : hi;
+                    v[ partner ] = ascending ? hi : lo;
+                }
+            }
+}
+
+#ifdef SORTING_NETWORK_AVX2
+
+/*
+ * AVX2 building blocks, one struct per key type.
+ * LANES is the number of keys in a 256-bit register;
+ * minMax( a, b, lo, hi ) sets lo = b < a ? b : a and
+ * hi = b < a ? a : b, lane by lane;
+ * laneSwap( x, j ) exchanges lane l with lane l ^ j;
+ * select( mask, a, b ) takes a where mask is set, else b.
+ */
+
+struct Avx2Int32
+{
+    typedef __m256i Reg;
+    static const int LANES = 8;
+
+    TARGET_AVX2 static Reg load( const void *p )
+      { return _mm256_load_si256( static_cast<const __m256i *>( p ) ); }
+    TARGET_AVX2 static void store( void *p, Reg x )
+      { _mm256_store_si256( static_cast<__m256i *>( p ), x ); }
+    TARGET_AVX2 static void minMax( Reg a, Reg b, Reg & lo, Reg & hi )
+    {
+        lo = _mm256_min_epi32( a, b );      // Equal ints are identical
+        hi = _mm256_max_epi32( a, b );
+    }
+    TARGET_AVX2 static Reg laneSwap( Reg x, int j )
+    {
+        __m256i lane = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+        return _mm256_permutevar8x32_epi32( x, _mm256_xor_si256( lane, _mm256_set1_epi32( j ) ) );
+    }
+    TARGET_AVX2 static Reg select( __m256i mask, Reg a, Reg b )
+      { return _mm256_blendv_epi8( b, a, mask ); }
+};
+
+struct Avx2Float
+{
+    typedef __m256 Reg;
+    static const int LANES = 8;
+
+    TARGET_AVX2 static Reg load( const void *p )
+      { return _mm256_load_ps( static_cast<const float *>( p ) ); }
+    TARGET_AVX2 static void store( void *p, Reg x )
+      { _mm256_store_ps( static_cast<float *>( p ), x ); }
+    TARGET_AVX2 static void minMax( Reg a, Reg b, Reg & lo, Reg & hi )
+    {
+        Reg less = _mm256_cmp_ps( b, a, _CMP_LT_OQ );
+        lo = _mm256_blendv_ps( a, b, less );
+        hi = _mm256_blendv_ps( b, a, less );
+    }
+    TARGET_AVX2 static Reg laneSwap( Reg x, int j )
+    {
+        __m256i lane = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+        return _mm256_permutevar8x32_ps( x, _mm256_xor_si256( lane, _mm256_set1_epi32( j ) ) );
+    }
+    TARGET_AVX2 static Reg select( __m256i mask, Reg a, Reg b )
+      { return _mm256_blendv_ps( b, a, _mm256_castsi256_ps( mask ) ); }
+};
+
+struct Avx2Int64
+{
+    typedef __m256i Reg;
+    static const int LANES = 4;
+
+    TARGET_AVX2 static Reg load( const void *p )
+      { return _mm256_load_si256( static_cast<const __m256i *>( p ) ); }
+    TARGET_AVX2 static void store( void *p, Reg x )
+      { _mm256_store_si256( static_cast<__m256i *>( p ), x ); }
+    TARGET_AVX2 static void minMax( Reg a, Reg b, Reg & lo, Reg & hi )
+    {
+        __m256i less = _mm256_cmpgt_epi64( a, b );
+        lo = _mm256_blendv_epi8( a, b, less );
+        hi = _mm256_blendv_epi8( b, a, less );
+    }
+    TARGET_AVX2 static Reg laneSwap( Reg x, int j )
+    {
+            // Move 64-bit lanes as pairs of 32-bit lanes
+        __m256i half = _mm256_setr_epi32( 0, 0, 1, 1, 2, 2, 3, 3 );
+        __m256i odd = _mm256_setr_epi32( 0, 1, 0, 1, 0, 1, 0, 1 );
+        __m256i from = _mm256_xor_si256( half, _mm256_set1_epi32( j ) );
+        from = _mm256_add_epi32( _mm256_add_epi32( from, from ), odd );
+        return _mm256_permutevar8x32_epi32( x, from );
+    }
+    TARGET_AVX2 static Reg select( __m256i mask, Reg a, Reg b )
+      { return _mm256_blendv_epi8( b, a, mask ); }
+};
+
+struct Avx2Double
+{
+    typedef __m256d Reg;
+    static const int LANES = 4;
+
+    TARGET_AVX2 static Reg load( const void *p )
+      { return _mm256_load_pd( static_cast<const double *>( p ) ); }
+    TARGET_AVX2 static void store( void *p, Reg x )
+      { _mm256_store_pd( static_cast<double *>( p ), x ); }
+    TARGET_AVX2 static void minMax( Reg a, Reg b, Reg & lo, Reg & hi )
+    {
+        Reg less = _mm256_cmp_pd( b, a, _CMP_LT_OQ );
+        lo = _mm256_blendv_pd( a, b, less );
+        hi = _mm256_blendv_pd( b, a, less );
+    }
+    TARGET_AVX2 static Reg laneSwap( Reg x, int j )
+    {
+        return _mm256_castsi256_pd( Avx2Int64::laneSwap( _mm256_castpd_si256( x ), j ) );
+    }
+    TARGET_AVX2 static Reg select( __m256i mask, Reg a, Reg b )
+      { return _mm256_blendv_pd( b, a, _mm256_castsi256_pd( mask ) ); }
+};
+
+/**
+ * Lane numbers of a register of Ops; for 64-bit keys each
+ * lane is a pair of 32-bit lanes.
+ */
+template <typename Ops>
+TARGET_AVX2 __m256i laneNumbers( )
+{
+    return Ops::LANES == 8 ? _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 )
+                           : _mm256_setr_epi32( 0, 0, 1, 1, 2, 2, 3, 3 );
+}
+
+/**
+ * Mask whose lane l is all ones if lane l is the lower
+ * of its pair at distance j (within a register).
+ */
+template <typename Ops>
+TARGET_AVX2 __m256i lowOfPairMask( int j )
+{
+    return _mm256_cmpeq_epi32( _mm256_and_si256( laneNumbers<Ops>( ), _mm256_set1_epi32( j ) ),
+                               _mm256_setzero_si256( ) );
+}
+
+/**
+ * Mask whose lane l is all ones if lane l, at position
+ * base + l of the network, keeps the minimum of its pair
+ * in the stage with distances j (within a register) and k.
+ */
+template <typename Ops>
+TARGET_AVX2 __m256i keepMinMask( int base, int j, int k )
+{
+    __m256i position = _mm256_add_epi32( laneNumbers<Ops>( ), _mm256_set1_epi32( base ) );
+    __m256i ascending = _mm256_cmpeq_epi32( _mm256_and_si256( position, _mm256_set1_epi32( k ) ),
+                                            _mm256_setzero_si256( ) );
+    return _mm256_cmpeq_epi32( lowOfPairMask<Ops>( j ), ascending );
+}
+
+/**
+ * The bitonic network of bitonicNetwork, on 32-byte aligned
+ * v[0..size-1], with size a multiple of Ops::LANES.
+ * Comparator distances of a register or more compare whole
+ * registers; shorter ones pair lanes within a register. Both
+ * lanes of a pair compare ( lower lane, upper lane ) in that
+ * order, so they agree on whether the pair is exchanged.
+ */
+template <typename Ops, typename T>
+TARGET_AVX2 void bitonicNetworkAvx2( T *v, int size )
+{
+    const int L = Ops::LANES;
+
+    for( int k = 2; k <= size; k *= 2 )
+        for( int j = k / 2; j > 0; j /= 2 )
+            if( j >= L )
+            {
+                for( int i = 0; i < size; i += L )
+                    if( ( i & j ) == 0 )
+                    {
+                        typename Ops::Reg x = Ops::load( v + i );
+                        typename Ops::Reg y = Ops::load( v + i + j );
+                        typename Ops::Reg lo, hi;
+                        Ops::minMax( x, y, lo, hi );
+                        bool ascending = ( i & k ) == 0;
+                        Ops::store( v + i, ascending ? lo : hi );
+                        Ops::store( v + i + j, ascending ? hi : lo );
+                    }
+            }
+            else
+            {
+                __m256i lowOfPair = lowOfPairMask<Ops>( j );
+                for( int i = 0; i < size; i += L )
+                {
+                    typename Ops::Reg x = Ops::load( v + i );
+                    typename Ops::Reg y = Ops::laneSwap( x, j );
+                    typename Ops::Reg lo, hi;
+                    Ops::minMax( Ops::select( lowOfPair, x, y ), Ops::select( lowOfPair, y, x ), lo, hi );
+                    Ops::store( v + i, Ops::select( keepMinMask<Ops>( i, j, k ), lo, hi ) );
+                }
+            }
+}
+
+/**
+ * Return true if the processor supports AVX2.
+ */
+inline bool hasAvx2( )
+{
+    static const bool supported = __builtin_cpu_supports( "avx2" );
+    return supported;
+}
+
+template <typename T>
+struct Avx2OpsFor
+{
+    typedef typename conditional<is_floating_point<T>::value,
+                typename conditional<sizeof( T ) == 4, Avx2Float, Avx2Double>::type,
+                typename conditional<sizeof( T ) == 4, Avx2Int32, Avx2Int64>::type>::type type;
+};
+
+#endif
+
+/**
+ * Sort a[0..n-1] with a sorting network; n <= NETWORK_CUTOFF.
+ */
+template <typename T>
+void networkSort( T *a, int n )
+{
+    static_assert( isNetworkSortable<T>::value, "networkSort needs a primitive key" );
+
+    if( n < 2 )
+        return;
+
+    alignas( 32 ) T v[ NETWORK_CUTOFF ];
+    int size = n <= 8 ? 8 : n <= 16 ? 16 : 32;
+
+    std::copy( a, a + n, v );
+    std::fill( v + n, v + size, networkPadding<T>( ) );
+
+#ifdef SORTING_NETWORK_AVX2
+    if( hasAvx2( ) )
+        bitonicNetworkAvx2<typename Avx2OpsFor<T>::type>( v, size );
+    else
+#endif
+        bitonicNetwork( v, size );
+
+    std::copy( v, v + n, a );
+}
+
+#endif
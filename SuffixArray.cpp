@@ -5,15 +5,38 @@
 #include <algorithm>
 #include <iterator>
 #include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <thread>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include "RunOnThreads.h"
+#include "MappedFile.h"
 using std::cout;
 using std::vector;
 using std::string;
 using std::endl;
 using std::invalid_argument;
 using std::sort;
+using std::ifstream;
+using std::ostringstream;
+
+enum class SuffixArrayAlgorithm { DC3, SAIS, PARALLEL };
   
 void makeLCPArray( vector<int> & s, const vector<int> & sa, vector<int> & LCP );
-void createSuffixArray( const string & str, vector<int> & sa, vector<int> & LCP );
+void createSuffixArray( const string & str, vector<int> & sa, vector<int> & LCP,
+                        SuffixArrayAlgorithm algorithm = SuffixArrayAlgorithm::DC3 );
+void makeSuffixArraySAIS( const unsigned char *text, int N, vector<int> & sa );
+void createSuffixArrayParallel( const unsigned char *text, int N, vector<int> & sa,
+                                int numThreads = std::thread::hardware_concurrency( ) );
+void makeLCPArray( const unsigned char *text, int N, const vector<int> & sa, vector<int> & LCP );
 void makeSuffixArray( const vector<int> & s, vector<int> & SA, int n, int K );
 int assignNames( const vector<int> & s, vector<int> & s12, vector<int> & SA12,
                                 int n0, int n12, int K );
@@ -77,14 +100,29 @@ void makeLCPArray( vector<int> & s, const vector<int> & sa, vector<int> & LCP )
  * str is the input String
  * sa is an existing array to place the suffix array
  * LCP is an existing array to place the LCP information
+ * algorithm is DC3 (the default); SAIS, which needs far less
+ * memory: about 5 bytes per character for the text and sa; or
+ * PARALLEL, prefix doubling on all cores.
  */
-void createSuffixArray( const string & str, vector<int> & sa, vector<int> & LCP )
+void createSuffixArray( const string & str, vector<int> & sa, vector<int> & LCP,
+                        SuffixArrayAlgorithm algorithm )
 {
     if( sa.size( ) != str.length( ) || LCP.size( ) != str.length( ) )
         throw invalid_argument{ "Mismatched vector sizes" };
     
     int N = str.length( );
 
+    if( algorithm != SuffixArrayAlgorithm::DC3 )
+    {
+        const unsigned char *text = reinterpret_cast<const unsigned char *>( str.data( ) );
+        if( algorithm == SuffixArrayAlgorithm::SAIS )
+            makeSuffixArraySAIS( text, N, sa );
+        else
+            createSuffixArrayParallel( text, N, sa );
+        makeLCPArray( text, N, sa, LCP );
+        return;
+    }
+
     vector<int> s( N + 3 );
     vector<int> SA( N + 3 );
 
@@ -279,6 +317,1181 @@ bool suffix12IsSmaller( const vector<int> & s, const vector<int> & s12,
                     s[ j ], s[ j + 1 ], s12[ j / 3 + n0 ] );
 }
 
+/*
+ * SA-IS: suffix array construction by induced sorting
+ * (Nong, Zhang, and Chan, 2009).
+ * Each suffix is S-type if it is smaller than the suffix after it,
+ * and L-type otherwise; an LMS position is an S-type position whose
+ * left neighbor is L-type. Sorting the LMS suffixes is enough: one
+ * left-to-right scan then induces the order of the L-type suffixes,
+ * and one right-to-left scan the order of the S-type suffixes.
+ * The LMS suffixes are sorted by naming the LMS substrings (found
+ * by the same two scans) and, if the names are not all distinct,
+ * solving the problem recursively on the string of names, which is
+ * at most half as long. The reduced string and its suffix array
+ * are kept inside SA, so besides the text and SA the only memory
+ * is one type bit per position and the buckets at each level.
+ *
+ * The texts are read through accessors so that the bytes of the
+ * input need not be copied to add the sentinel: ByteText maps the
+ * bytes to 1..256 and returns 0, the unique smallest symbol, at
+ * position N. At deeper levels the text is a run of ints in SA.
+ */
+
+struct ByteText
+{
+    const unsigned char *bytes;
+    int N;
+
+    int operator[]( int i ) const
+      { return i < N ? bytes[ i ] + 1 : 0; }
+};
+
+struct IntText
+{
+    const int *symbols;
+
+    int operator[]( int i ) const
+      { return symbols[ i ]; }
+};
+
+// Fill bkt[0..K-1] with the start (or end) of each symbol's bucket
+template <typename Text>
+void getBuckets( const Text & s, vector<int> & bkt, int n, int K, bool end )
+{
+    std::fill( bkt.begin( ), bkt.begin( ) + K, 0 );
+    for( int i = 0; i < n; ++i )
+        ++bkt[ s[ i ] ];
+
+    for( int c = 0, sum = 0; c < K; ++c )
+    {
+        sum += bkt[ c ];
+        bkt[ c ] = end ? sum : sum - bkt[ c ];
+    }
+}
+
+inline bool isLMS( const vector<bool> & isS, int i )
+{
+    return i > 0 && isS[ i ] && !isS[ i - 1 ];
+}
+
+// Induce the order of the L-type suffixes, then the S-type suffixes,
+// from the LMS suffixes already placed at the ends of their buckets
+template <typename Text>
+void induceSA( const Text & s, const vector<bool> & isS, int *SA,
+               vector<int> & bkt, int n, int K )
+{
+    getBuckets( s, bkt, n, K, false );
+    for( int i = 0; i < n; ++i )
+    {
+        int j = SA[ i ] - 1;
+        if( SA[ i ] > 0 && !isS[ j ] )
+            SA[ bkt[ s[ j ] ]++ ] = j;
+    }
+
+    getBuckets( s, bkt, n, K, true );
+    for( int i = n - 1; i >= 0; --i )
+    {
+        int j = SA[ i ] - 1;
+        if( SA[ i ] > 0 && isS[ j ] )
+            SA[ --bkt[ s[ j ] ] ] = j;
+    }
+}
+
+// find the suffix array SA of s[0..n-1] in {0..K-1}^n
+// require s[n-1]=0 and s[i]>0 for i<n-1
+template <typename Text>
+void makeSuffixArraySAIS( const Text & s, int *SA, int n, int K )
+{
+    vector<bool> isS( n );
+    isS[ n - 1 ] = true;
+    for( int i = n - 2; i >= 0; --i )
+        isS[ i ] = s[ i ] < s[ i + 1 ] || ( s[ i ] == s[ i + 1 ] && isS[ i + 1 ] );
+
+        // Stage 1: sort the LMS substrings
+    vector<int> bkt( K );
+    getBuckets( s, bkt, n, K, true );
+    std::fill( SA, SA + n, -1 );
+    for( int i = 1; i < n; ++i )
+        if( isLMS( isS, i ) )
+            SA[ --bkt[ s[ i ] ] ] = i;
+    induceSA( s, isS, SA, bkt, n, K );
+
+        // Compact the sorted LMS substrings into SA[0..n1-1]
+    int n1 = 0;
+    for( int i = 0; i < n; ++i )
+        if( isLMS( isS, SA[ i ] ) )
+            SA[ n1++ ] = SA[ i ];
+
+        // Name them; equal substrings get equal names. Position p
+        // of the text is stored at SA[ n1 + p / 2 ], as LMS positions
+        // are at least two apart
+    std::fill( SA + n1, SA + n, -1 );
+    int name = 0, prev = -1;
+    for( int i = 0; i < n1; ++i )
+    {
+        int pos = SA[ i ];
+        bool diff = prev == -1;
+
+        for( int d = 0; !diff; ++d )
+            if( s[ pos + d ] != s[ prev + d ] || isS[ pos + d ] != isS[ prev + d ] )
+                diff = true;
+            else if( d > 0 && ( isLMS( isS, pos + d ) || isLMS( isS, prev + d ) ) )
+                break;
+
+        if( diff )
+        {
+            ++name;
+            prev = pos;
+        }
+        SA[ n1 + pos / 2 ] = name - 1;
+    }
+    for( int i = n - 1, j = n - 1; i >= n1; --i )
+        if( SA[ i ] >= 0 )
+            SA[ j-- ] = SA[ i ];
+
+        // Stage 2: sort the LMS suffixes, recursing if names repeat
+    int *SA1 = SA, *s1 = SA + n - n1;
+    if( name < n1 )
+        makeSuffixArraySAIS( IntText{ s1 }, SA1, n1, name );
+    else
+        for( int i = 0; i < n1; ++i )
+            SA1[ s1[ i ] ] = i;
+
+        // Stage 3: place the sorted LMS suffixes and induce the rest
+    for( int i = 1, j = 0; i < n; ++i )
+        if( isLMS( isS, i ) )
+            s1[ j++ ] = i;
+    for( int i = 0; i < n1; ++i )
+        SA1[ i ] = s1[ SA1[ i ] ];
+    std::fill( SA + n1, SA + n, -1 );
+
+    getBuckets( s, bkt, n, K, true );
+    for( int i = n1 - 1; i >= 0; --i )
+    {
+        int j = SA[ i ];
+        SA[ i ] = -1;
+        SA[ --bkt[ s[ j ] ] ] = j;
+    }
+    induceSA( s, isS, SA, bkt, n, K );
+}
+
+/*
+ * Build the suffix array of text[0..N-1] with SA-IS into sa.
+ * sa is resized to N; its old contents are released first, so
+ * the peak memory is the text, 4(N+1) bytes for the result, and
+ * the type bits and buckets.
+ */
+void makeSuffixArraySAIS( const unsigned char *text, int N, vector<int> & sa )
+{
+    vector<int>( ).swap( sa );
+    sa.resize( N + 1 );
+    makeSuffixArraySAIS( ByteText{ text, N }, &sa[ 0 ], N + 1, 257 );
+    sa.erase( sa.begin( ) );     // The sentinel's suffix, always first
+}
+
+/*
+ * Create the LCP array from the suffix array, for a text of bytes
+ * (Kasai et al., in the permuted form of Karkkainen, Manzini, and
+ * Puglisi). LCP first holds, for each text position, the position
+ * of the suffix just before it in sa; that is replaced in text order
+ * by the permuted LCP, which is then moved into suffix array order
+ * by following cycles. Needs no memory beyond LCP but a bit per
+ * position.
+ */
+void makeLCPArray( const unsigned char *text, int N, const vector<int> & sa, vector<int> & LCP )
+{
+    if( N == 0 )
+        return;
+
+    vector<int> & phi = LCP;
+    phi[ sa[ 0 ] ] = -1;
+    for( int i = 1; i < N; ++i )
+        phi[ sa[ i ] ] = sa[ i - 1 ];
+
+    vector<int> & plcp = LCP;
+    for( int i = 0, h = 0; i < N; ++i )
+    {
+        int j = phi[ i ];
+        if( j < 0 )
+            h = 0;
+        else
+            while( i + h < N && j + h < N && text[ i + h ] == text[ j + h ] )
+                ++h;
+
+        plcp[ i ] = h;
+        if( h > 0 )
+            --h;
+    }
+
+        // LCP[ r ] = plcp[ sa[ r ] ], in place
+    vector<bool> done( N );
+    for( int start = 0; start < N; ++start )
+    {
+        if( done[ start ] )
+            continue;
+
+        int tmp = plcp[ start ];
+        int hole = start;
+        for( int from; ( from = sa[ hole ] ) != start; hole = from )
+        {
+            LCP[ hole ] = plcp[ from ];
+            done[ hole ] = true;
+        }
+        LCP[ hole ] = tmp;
+        done[ hole ] = true;
+    }
+}
+
+// stably sort pos[0..n-1] by key[0..n-1], the low keyBits of each key,
+// using LSD radix sort with numThreads threads; tmpKey and tmpPos are
+// scratch arrays of size n. Each pass counts digits per thread, turns
+// the counts into per-thread offsets, and scatters concurrently.
+// A pass whose digit is the same for every key is skipped.
+void parallelRadixSort( vector<uint64_t> & key, vector<int> & pos,
+                        vector<uint64_t> & tmpKey, vector<int> & tmpPos,
+                        int keyBits, int numThreads )
+{
+    const int DIGIT_BITS = 11;
+    const int BUCKETS = 1 << DIGIT_BITS;
+    int n = key.size( );
+
+    vector<vector<int>> count( numThreads, vector<int>( BUCKETS ) );
+
+    for( int shift = 0; shift < keyBits; shift += DIGIT_BITS )
+    {
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            vector<int> & myCount = count[ t ];
+            std::fill( myCount.begin( ), myCount.end( ), 0 );
+            for( int i = sliceBegin( n, t, numThreads ); i < sliceBegin( n, t + 1, numThreads ); ++i )
+                ++myCount[ ( key[ i ] >> shift ) & ( BUCKETS - 1 ) ];
+        } );
+
+        bool allSame = false;
+        for( int b = 0, offset = 0; b < BUCKETS; ++b )
+        {
+            int total = 0;
+            for( int t = 0; t < numThreads; ++t )
+            {
+                int c = count[ t ][ b ];
+                count[ t ][ b ] = offset;
+                offset += c;
+                total += c;
+            }
+            allSame = allSame || total == n;
+        }
+        if( allSame )
+            continue;
+
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            vector<int> & next = count[ t ];
+            for( int i = sliceBegin( n, t, numThreads ); i < sliceBegin( n, t + 1, numThreads ); ++i )
+            {
+                int dest = next[ ( key[ i ] >> shift ) & ( BUCKETS - 1 ) ]++;
+                tmpKey[ dest ] = key[ i ];
+                tmpPos[ dest ] = pos[ i ];
+            }
+        } );
+
+        key.swap( tmpKey );
+        pos.swap( tmpPos );
+    }
+}
+
+// Number of bits needed to hold the values 0..maxValue
+inline int bitsFor( uint64_t maxValue )
+{
+    int bits = 0;
+    while( bits < 64 && ( maxValue >> bits ) != 0 )
+        ++bits;
+    return bits;
+}
+
+/*
+ * Build the suffix array of text[0..N-1] into sa, by prefix doubling
+ * (Manber and Myers) with numThreads threads.
+ * Each round gives every suffix the rank of its first h characters
+ * among all suffixes; sorting the suffixes by the pairs
+ * (rank of i, rank of i + h) gives the ranks for 2h characters.
+ * The pairs are built in text order, packed into 64-bit keys, and
+ * sorted by a parallel LSD radix sort; new ranks are assigned by a
+ * parallel scan for key changes. Stops once all ranks differ, after
+ * about log2 of the longest repeat rounds.
+ * Uses about 28 bytes per character (keys and positions, double
+ * buffered, and the ranks), far more than SA-IS, in exchange for
+ * scaling with the core count.
+ */
+void createSuffixArrayParallel( const unsigned char *text, int N, vector<int> & sa,
+                                int numThreads )
+{
+    numThreads = std::max( 1, std::min( numThreads, N / 65536 + 1 ) );
+
+    vector<int> rank( N );
+    vector<uint64_t> key( N ), tmpKey( N );
+    vector<int> pos( N ), tmpPos( N );
+    vector<int> heads( numThreads + 1 );
+
+    int maxRank = 255;
+    for( int i = 0; i < N; ++i )
+        rank[ i ] = text[ i ];
+
+    for( int h = 1; ; h *= 2 )
+    {
+        int rankBits = bitsFor( maxRank + 1 );
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            for( int i = sliceBegin( N, t, numThreads ); i < sliceBegin( N, t + 1, numThreads ); ++i )
+            {
+                uint64_t second = i + h < N ? rank[ i + h ] + 1 : 0;
+                key[ i ] = uint64_t( rank[ i ] ) << rankBits | second;
+                pos[ i ] = i;
+            }
+        } );
+
+        parallelRadixSort( key, pos, tmpKey, tmpPos, 2 * rankBits, numThreads );
+
+            // Each thread counts the group heads in its slice ...
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            int count = 0;
+            for( int i = sliceBegin( N, t, numThreads ); i < sliceBegin( N, t + 1, numThreads ); ++i )
+                count += i == 0 || key[ i ] != key[ i - 1 ];
+            heads[ t + 1 ] = count;
+        } );
+        for( int t = 1; t <= numThreads; ++t )
+            heads[ t ] += heads[ t - 1 ];
+
+            // ... and then ranks its slice, starting after the heads before it
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            int r = heads[ t ] - 1;
+            for( int i = sliceBegin( N, t, numThreads ); i < sliceBegin( N, t + 1, numThreads ); ++i )
+            {
+                r += i == 0 || key[ i ] != key[ i - 1 ];
+                rank[ pos[ i ] ] = r;
+            }
+        } );
+
+        maxRank = heads[ numThreads ] - 1;
+        if( maxRank == N - 1 || h >= N )
+            break;
+    }
+
+    sa.swap( pos );
+}
+
+/*
+ * Pattern queries on a text and its suffix array.
+ * The text, suffix array, and LCP-lr arrays are read through
+ * pointers, so they may live in vectors or in a mapped index file.
+ *
+ * The binary search keeps l and r, the lengths of the longest common
+ * prefixes of the pattern with the suffixes at the two ends of the
+ * current range. The LCP-lr arrays give, for each midpoint M of the
+ * search, the LCP of suffix M with the suffixes at the two ends of
+ * the range that M splits (Manber and Myers). Comparing the larger
+ * of l and r with the matching LCP-lr entry either decides the step
+ * with no character comparisons or lets the comparison start at
+ * max( l, r ), so no character of the pattern is matched twice and a
+ * search costs O( m + log N ) for a pattern of length m.
+ */
+class SuffixArrayIndex
+{
+  public:
+    // Index text[0..N-1] with its suffix array sa and LCP array;
+    // computes the LCP-lr arrays from LCP
+    SuffixArrayIndex( const unsigned char *text, int N, const int *sa, const int *LCP )
+      : text{ text }, N{ N }, sa{ sa }, ownedLlcp( N ), ownedRlcp( N )
+    {
+        llcp = ownedLlcp.data( );
+        rlcp = ownedRlcp.data( );
+        fillLcpLR( LCP, -1, N );
+    }
+
+    // Index text[0..N-1] with sa and precomputed LCP-lr arrays
+    SuffixArrayIndex( const unsigned char *text, int N, const int *sa,
+                      const int *llcp, const int *rlcp )
+      : text{ text }, N{ N }, sa{ sa }, llcp{ llcp }, rlcp{ rlcp }
+    {
+    }
+
+    SuffixArrayIndex( const SuffixArrayIndex & rhs ) = delete;
+    SuffixArrayIndex & operator= ( const SuffixArrayIndex & rhs ) = delete;
+    SuffixArrayIndex( SuffixArrayIndex && rhs ) = default;
+
+    // Number of occurrences of pattern
+    int count( const string & pattern ) const
+    {
+        std::pair<int, int> r = range( pattern );
+        return r.second - r.first;
+    }
+
+    // Text positions of all occurrences of pattern, in suffix order
+    vector<int> locate( const string & pattern ) const
+    {
+        std::pair<int, int> r = range( pattern );
+        return vector<int>( sa + r.first, sa + r.second );
+    }
+
+    // The first k of the positions that locate would return,
+    // without reading the rest
+    vector<int> locateFirstK( const string & pattern, int k ) const
+    {
+        std::pair<int, int> r = range( pattern );
+        return vector<int>( sa + r.first, sa + std::min( r.second, r.first + std::max( k, 0 ) ) );
+    }
+
+    // The range [first, second) of sa holding the suffixes that
+    // start with pattern
+    std::pair<int, int> range( const string & pattern ) const
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>( pattern.data( ) );
+        int m = pattern.length( );
+        return { search( p, m, false ), search( p, m, true ) };
+    }
+
+    /*
+     * Answer every pattern in patterns, calling
+     * report( i, positions, numPositions, count ) for pattern i.
+     * count is its number of occurrences, and positions points at
+     * the text positions of the first numPositions of them, in
+     * suffix order, inside the suffix array (valid while the index
+     * is); numPositions is at most maxPerPattern. Patterns are searched in sorted order, so that
+     * consecutive searches walk the same paths through sa and text.
+     */
+    template <typename Callback>
+    void batch( const vector<string> & patterns, Callback report,
+                int maxPerPattern = std::numeric_limits<int>::max( ) ) const
+    {
+        vector<int> order( patterns.size( ) );
+        for( int i = 0; i < order.size( ); ++i )
+            order[ i ] = i;
+        sort( order.begin( ), order.end( ),
+              [ & ] ( int a, int b ) { return patterns[ a ] < patterns[ b ]; } );
+
+        for( int i : order )
+        {
+            std::pair<int, int> r = range( patterns[ i ] );
+            int count = r.second - r.first;
+            report( i, sa + r.first, std::min( count, maxPerPattern ), count );
+        }
+    }
+
+    int size( ) const
+      { return N; }
+
+    // The LCP-lr arrays, for saving the index
+    const int * leftLcp( ) const
+      { return llcp; }
+    const int * rightLcp( ) const
+      { return rlcp; }
+
+  private:
+    const unsigned char *text;
+    int N;
+    const int *sa;
+    const int *llcp;      // llcp[ M ] = LCP of suffix M and the left end of its range
+    const int *rlcp;      // rlcp[ M ] = LCP of suffix M and the right end of its range
+    vector<int> ownedLlcp;
+    vector<int> ownedRlcp;
+
+    // Fill the LCP-lr entries for the midpoints strictly between
+    // L and R; returns the LCP of the suffixes at L and R, which is
+    // 0 when either is the virtual end -1 or N
+    int fillLcpLR( const int *LCP, int L, int R )
+    {
+        if( R - L == 1 )
+            return L < 0 || R >= N ? 0 : LCP[ R ];
+
+        int M = L + ( R - L ) / 2;
+        int left = fillLcpLR( LCP, L, M );
+        int right = fillLcpLR( LCP, M, R );
+        ownedLlcp[ M ] = left;
+        ownedRlcp[ M ] = right;
+        return L < 0 || R >= N ? 0 : std::min( left, right );
+    }
+
+    // Extend a match of pattern p[0..m-1] with suffix s from
+    // position k; returns the new length of the match
+    int extend( const unsigned char *p, int m, int s, int k ) const
+    {
+        while( k < m && s + k < N && p[ k ] == text[ s + k ] )
+            ++k;
+        return k;
+    }
+
+    // True if the pattern goes at or before suffix s, given that
+    // they agree on their first k characters. For the upper end of
+    // a range, a pattern that is a prefix of s goes after it
+    bool goesBefore( const unsigned char *p, int m, int s, int k, bool upper ) const
+    {
+        if( k == m )
+            return !upper;
+        return s + k < N && p[ k ] < text[ s + k ];
+    }
+
+    // First position in sa whose suffix is at or after the pattern
+    // (upper false), or after every suffix that starts with it
+    int search( const unsigned char *p, int m, bool upper ) const
+    {
+        int L = -1, R = N;
+        int l = 0, r = 0;
+
+        while( R - L > 1 )
+        {
+            int M = L + ( R - L ) / 2;
+            int k;
+
+            if( l >= r )
+            {
+                if( llcp[ M ] > l )         // M agrees with L past l
+                {
+                    L = M;
+                    continue;
+                }
+                if( llcp[ M ] < l )         // M is past the pattern
+                {
+                    R = M;
+                    r = llcp[ M ];
+                    continue;
+                }
+                k = extend( p, m, sa[ M ], l );
+            }
+            else
+            {
+                if( rlcp[ M ] > r )         // M agrees with R past r
+                {
+                    R = M;
+                    continue;
+                }
+                if( rlcp[ M ] < r )         // M is before the pattern
+                {
+                    L = M;
+                    l = rlcp[ M ];
+                    continue;
+                }
+                k = extend( p, m, sa[ M ], r );
+            }
+
+            if( goesBefore( p, m, sa[ M ], k, upper ) )
+            {
+                R = M;
+                r = k;
+            }
+            else
+            {
+                L = M;
+                l = k;
+            }
+        }
+
+        return R;
+    }
+};
+
+/*
+ * A bitvector with a rank directory: one 32-bit count of the
+ * ones before each block of 512 bits, so rank costs at most
+ * eight popcounts and the directory adds 6.25% to the bits.
+ */
+class RankBitvector
+{
+  public:
+    explicit RankBitvector( int n = 0 )
+      : words( n / 64 + 1 ), blockRanks( n / 512 + 1 )
+    {
+    }
+
+    void set( int i )
+      { words[ i / 64 ] |= uint64_t( 1 ) << ( i % 64 ); }
+
+    bool operator[]( int i ) const
+      { return ( words[ i / 64 ] >> ( i % 64 ) ) & 1; }
+
+    // Fill the rank directory; call after the last set
+    void buildRanks( )
+    {
+        uint32_t ones = 0;
+        for( int w = 0; w < words.size( ); ++w )
+        {
+            if( w % 8 == 0 )
+                blockRanks[ w / 8 ] = ones;
+            ones += __builtin_popcountll( words[ w ] );
+        }
+    }
+
+    // Number of ones in positions 0..i-1
+    int rank1( int i ) const
+    {
+        int w = i / 64;
+        int r = blockRanks[ w / 8 ];
+        for( int k = w & ~7; k < w; ++k )
+            r += __builtin_popcountll( words[ k ] );
+        return r + __builtin_popcountll( words[ w ] & ( ( uint64_t( 1 ) << ( i % 64 ) ) - 1 ) );
+    }
+
+    // Number of zeros in positions 0..i-1
+    int rank0( int i ) const
+      { return i - rank1( i ); }
+
+    long long sizeInBytes( ) const
+      { return words.size( ) * sizeof( uint64_t ) + blockRanks.size( ) * sizeof( uint32_t ); }
+
+  private:
+    vector<uint64_t> words;
+    vector<uint32_t> blockRanks;
+};
+
+/*
+ * A wavelet matrix (Claude, Navarro, and Ordonez) over a sequence
+ * of symbols 0..2^levels-1. Level l holds bit l (from the top) of
+ * every symbol, with the symbols stably sorted by their higher bits,
+ * zeros first; so rank and access take one rank per level.
+ */
+class WaveletMatrix
+{
+  public:
+    WaveletMatrix( ) : levels{ 0 }
+    {
+    }
+
+    WaveletMatrix( vector<unsigned char> symbols, int numLevels )
+      : levels{ numLevels }, rows( numLevels ), zeros( numLevels )
+    {
+        int n = symbols.size( );
+        vector<unsigned char> next( n );
+
+        for( int l = 0; l < levels; ++l )
+        {
+            int shift = levels - 1 - l;
+            rows[ l ] = RankBitvector( n );
+            int numZeros = 0;
+            for( int i = 0; i < n; ++i )
+                if( ( symbols[ i ] >> shift ) & 1 )
+                    rows[ l ].set( i );
+                else
+                    ++numZeros;
+            rows[ l ].buildRanks( );
+            zeros[ l ] = numZeros;
+
+                // Stable partition by this bit for the next level
+            int z = 0, o = numZeros;
+            for( int i = 0; i < n; ++i )
+                next[ ( ( symbols[ i ] >> shift ) & 1 ) ? o++ : z++ ] = symbols[ i ];
+            symbols.swap( next );
+        }
+    }
+
+    // Number of occurrences of symbol c in positions 0..i-1
+    int rank( int c, int i ) const
+    {
+        int p = 0;
+        for( int l = 0; l < levels; ++l )
+            if( ( c >> ( levels - 1 - l ) ) & 1 )
+            {
+                i = zeros[ l ] + rows[ l ].rank1( i );
+                p = zeros[ l ] + rows[ l ].rank1( p );
+            }
+            else
+            {
+                i = rows[ l ].rank0( i );
+                p = rows[ l ].rank0( p );
+            }
+        return i - p;
+    }
+
+    // The symbol at position i
+    int access( int i ) const
+    {
+        int c = 0;
+        for( int l = 0; l < levels; ++l )
+        {
+            bool bit = rows[ l ][ i ];
+            c = c << 1 | bit;
+            i = bit ? zeros[ l ] + rows[ l ].rank1( i ) : rows[ l ].rank0( i );
+        }
+        return c;
+    }
+
+    long long sizeInBytes( ) const
+    {
+        long long bytes = 0;
+        for( const RankBitvector & row : rows )
+            bytes += row.sizeInBytes( );
+        return bytes + zeros.size( ) * sizeof( int );
+    }
+
+  private:
+    int levels;
+    vector<RankBitvector> rows;
+    vector<int> zeros;
+};
+
+/*
+ * FM-index: a compressed index of a text, built from its suffix array.
+ * Row r of the Burrows-Wheeler matrix is the r-th smallest rotation of
+ * text$, so row 0 is the suffix $ and row r > 0 is suffix sa[r-1]; the
+ * BWT is the character before each row's suffix. The BWT is kept in a
+ * wavelet matrix over only the characters that occur, so it takes
+ * ceil(log2 sigma) bits per character plus the rank directories.
+ * count is a backward search: one pair of wavelet ranks per pattern
+ * character, never touching the text. For locate, the positions that
+ * are multiples of sampleRate are kept, marked by row; other rows
+ * step back through the text by LF until they reach a sample, at
+ * most sampleRate - 1 steps.
+ * The $ is stored as the smallest character, and rank corrects for it.
+ */
+class FMIndex
+{
+  public:
+    FMIndex( const unsigned char *text, int N, const int *sa, int sampleRate = 32 )
+      : N{ N }, sampleRate{ sampleRate }, code( 256, -1 ), C( 257 ),
+        dollarRow{ 0 }, marked( N + 1 )
+    {
+        vector<int> freq( 256 );
+        for( int i = 0; i < N; ++i )
+            ++freq[ text[ i ] ];
+
+        int sigma = 0;
+        for( int ch = 0; ch < 256; ++ch )
+            if( freq[ ch ] > 0 )
+            {
+                C[ sigma + 1 ] = C[ sigma ] + freq[ ch ];
+                code[ ch ] = sigma++;
+            }
+        for( int c = 0; c <= sigma; ++c )
+            C[ c ] += 1;                    // Row 0, the suffix $, comes first
+
+        vector<unsigned char> bwt( N + 1 );
+        bwt[ 0 ] = N > 0 ? code[ text[ N - 1 ] ] : 0;
+        for( int r = 1; r <= N; ++r )
+        {
+            int p = sa[ r - 1 ];
+            if( p == 0 )
+                dollarRow = r;
+            else
+                bwt[ r ] = code[ text[ p - 1 ] ];
+
+            if( p % sampleRate == 0 )
+            {
+                marked.set( r );
+                samples.push_back( p );
+            }
+        }
+        marked.buildRanks( );
+        wavelet = WaveletMatrix( bwt, std::max( 1, bitsFor( std::max( sigma - 1, 0 ) ) ) );
+    }
+
+    // Number of occurrences of pattern
+    int count( const string & pattern ) const
+    {
+        std::pair<int, int> r = range( pattern );
+        return r.second - r.first;
+    }
+
+    // Text positions of up to maxResults occurrences of pattern
+    vector<int> locate( const string & pattern,
+                        int maxResults = std::numeric_limits<int>::max( ) ) const
+    {
+        std::pair<int, int> r = range( pattern );
+        vector<int> positions;
+
+        for( int row = r.first; row < r.second && int( positions.size( ) ) < maxResults; ++row )
+        {
+            int steps = 0, at = row;
+            while( !marked[ at ] )
+            {
+                at = LF( at );
+                ++steps;
+            }
+            positions.push_back( samples[ marked.rank1( at ) ] + steps );
+        }
+        return positions;
+    }
+
+    // The rows [first, second) whose suffixes start with pattern
+    std::pair<int, int> range( const string & pattern ) const
+    {
+        if( pattern.empty( ) )
+            return { 1, N + 1 };
+
+        int sp = 0, ep = N + 1;
+        for( int i = pattern.length( ) - 1; i >= 0 && sp < ep; --i )
+        {
+            int c = code[ static_cast<unsigned char>( pattern[ i ] ) ];
+            if( c < 0 )
+                return { 0, 0 };
+            sp = C[ c ] + rank( c, sp );
+            ep = C[ c ] + rank( c, ep );
+        }
+        return { sp, ep };
+    }
+
+    // Bytes for count (the wavelet matrix and C)
+    long long countSizeInBytes( ) const
+      { return wavelet.sizeInBytes( ) + C.size( ) * sizeof( int ) + code.size( ) * sizeof( int ); }
+
+    // Bytes for count and locate
+    long long sizeInBytes( ) const
+      { return countSizeInBytes( ) + marked.sizeInBytes( ) + samples.size( ) * sizeof( int ); }
+
+  private:
+    int N;
+    int sampleRate;
+    vector<int> code;           // Character to symbol, or -1 if absent
+    vector<int> C;              // Rows before the first suffix starting with symbol c
+    int dollarRow;              // Row whose BWT character is $
+    WaveletMatrix wavelet;      // The BWT, as symbols
+    RankBitvector marked;       // Rows whose positions are sampled
+    vector<int> samples;        // Their positions, by row
+
+    // Occurrences of symbol c in BWT rows 0..i-1, not counting the $
+    int rank( int c, int i ) const
+      { return wavelet.rank( c, i ) - ( c == 0 && i > dollarRow ); }
+
+    // Row of the suffix one position earlier in the text
+    int LF( int row ) const
+    {
+        int c = wavelet.access( row );
+        return C[ c ] + rank( c, row );
+    }
+};
+
+/*
+ * Longest common extension queries: the length of the longest common
+ * prefix of the suffixes at any two text positions, in O(1) time.
+ * It is the minimum of LCP over the ranks between the two suffixes,
+ * so the index keeps the inverse suffix array and a range-minimum
+ * structure over LCP. LCP is split into blocks of 32; a sparse table
+ * over the block minima answers the blocks a query covers whole, and
+ * within a block, mask[ k ] has a bit for each position of the block
+ * up to k whose LCP is smaller than everything after it up to k, so
+ * the minimum of a piece of a block is at the lowest bit of mask that
+ * is inside the piece. Space beyond LCP is 8N bytes for the inverse
+ * and the masks, plus (N/8) log2(N/32) for the sparse table.
+ */
+class LceIndex
+{
+  public:
+    // Index the text with suffix array sa and LCP array LCP,
+    // where LCP[ r ] is the LCP of the suffixes at ranks r-1 and r
+    LceIndex( const int *sa, const int *LCP, int N )
+      : N{ N }, LCP{ LCP }, rank( N ), mask( N )
+    {
+        for( int r = 0; r < N; ++r )
+            rank[ sa[ r ] ] = r;
+
+        int numBlocks = ( N + BLOCK - 1 ) / BLOCK;
+        sparse.push_back( vector<int>( numBlocks ) );
+        for( int b = 0; b < numBlocks; ++b )
+        {
+            int first = b * BLOCK;
+            uint32_t m = 0;
+            for( int k = first; k < N && k < first + BLOCK; ++k )
+            {
+                while( m != 0 && LCP[ first + 31 - __builtin_clz( m ) ] >= LCP[ k ] )
+                    m &= ~( uint32_t( 1 ) << ( 31 - __builtin_clz( m ) ) );
+                m |= uint32_t( 1 ) << ( k - first );
+                mask[ k ] = m;
+            }
+            sparse[ 0 ][ b ] = LCP[ first + __builtin_ctz( m ) ];
+        }
+
+        for( int len = 2; len <= numBlocks; len *= 2 )
+        {
+            const vector<int> & prev = sparse.back( );
+            vector<int> level( numBlocks - len + 1 );
+            for( int b = 0; b < level.size( ); ++b )
+                level[ b ] = std::min( prev[ b ], prev[ b + len / 2 ] );
+            sparse.push_back( std::move( level ) );
+        }
+    }
+
+    // Length of the longest common prefix of the suffixes at i and j
+    int lce( int i, int j ) const
+    {
+        if( i == j )
+            return N - i;
+        int lo = rank[ i ], hi = rank[ j ];
+        if( lo > hi )
+            std::swap( lo, hi );
+        return rangeMin( lo + 1, hi );
+    }
+
+    /*
+     * Number of mismatches between text[i..i+length-1] and
+     * text[j..j+length-1], found by jumping over matches with lce,
+     * so it costs O(maxMismatches) queries; stops counting at
+     * maxMismatches + 1. Both ranges must be inside the text.
+     */
+    int mismatches( int i, int j, int length, int maxMismatches ) const
+    {
+        int count = 0;
+        for( int k = 0; count <= maxMismatches; ++count, ++k )
+        {
+            k += std::min( i + k < N && j + k < N ? lce( i + k, j + k ) : 0, length - k );
+            if( k >= length )
+                break;
+        }
+        return count;
+    }
+
+    // The minimum of LCP[ lo..hi ], lo <= hi
+    int rangeMin( int lo, int hi ) const
+    {
+        int bLo = lo / BLOCK, bHi = hi / BLOCK;
+        if( bLo == bHi )
+            return inBlock( lo, hi );
+
+        int m = std::min( inBlock( lo, bLo * BLOCK + BLOCK - 1 ), inBlock( bHi * BLOCK, hi ) );
+        if( bHi - bLo > 1 )
+        {
+            int level = 31 - __builtin_clz( bHi - bLo - 1 );
+            m = std::min( m, std::min( sparse[ level ][ bLo + 1 ],
+                                       sparse[ level ][ bHi - ( 1 << level ) ] ) );
+        }
+        return m;
+    }
+
+    long long sizeInBytes( ) const
+    {
+        long long bytes = rank.size( ) * sizeof( int ) + mask.size( ) * sizeof( uint32_t );
+        for( const vector<int> & level : sparse )
+            bytes += level.size( ) * sizeof( int );
+        return bytes;
+    }
+
+  private:
+    static const int BLOCK = 32;
+
+    int N;
+    const int *LCP;
+    vector<int> rank;               // Inverse suffix array
+    vector<uint32_t> mask;          // In-block minimum candidates
+    vector<vector<int>> sparse;     // sparse[ l ][ b ] = min of blocks b..b+2^l-1
+
+    int inBlock( int lo, int hi ) const
+    {
+        uint32_t m = mask[ hi ] & ( ~uint32_t( 0 ) << ( lo % BLOCK ) );
+        return LCP[ hi - hi % BLOCK + __builtin_ctz( m ) ];
+    }
+};
+
+/*
+ * A suffix array index saved to disk and opened with mmap, so that
+ * a process can answer queries without building anything: the
+ * arrays are used in place (see MappedFile.h).
+ *
+ * Layout (native byte order, every section starting on a 64-byte
+ * boundary):
+ *     IndexHeader
+ *     IndexSection[ numSections ]
+ *     the sections, in table order
+ * Sections TEXT, SA, and LCP are always present. LLCP and RLCP, the
+ * LCP-lr arrays that SuffixArrayIndex searches with, are optional;
+ * without them they are rebuilt from LCP at open, which costs O(N)
+ * time and 8N bytes of private memory. A reader skips sections it
+ * does not know, so new ones can be added without a version change.
+ *
+ * Opening checks the magic, version, byte order, and header
+ * checksum, and that every section lies inside the file; verify
+ * checks the section checksums, which means reading every page.
+ */
+class SuffixArrayFile
+{
+  public:
+    enum SectionId : uint32_t { TEXT = 1, SA = 2, LCP = 3, LLCP = 4, RLCP = 5 };
+
+    explicit SuffixArrayFile( const string & fileName )
+      : file{ fileName }, header{ readHeader( file, fileName ) },
+        index{ makeIndex( ) }
+    {
+    }
+
+    /*
+     * Write the index of text[0..N-1], with its suffix array and
+     * LCP array, to fileName; the LCP-lr arrays are included if
+     * withLcpLR is true
+     */
+    static void write( const string & fileName, const unsigned char *text, int N,
+                       const int *sa, const int *lcpArray, bool withLcpLR = true )
+    {
+        SuffixArrayIndex lcpLR{ text, N, sa, lcpArray };
+        vector<std::pair<SectionId, std::pair<const void *, uint64_t>>> contents = {
+            { TEXT, { text, uint64_t( N ) } },
+            { SA, { sa, N * sizeof( int ) } },
+            { LCP, { lcpArray, N * sizeof( int ) } } };
+        if( withLcpLR )
+        {
+            contents.push_back( { LLCP, { lcpLR.leftLcp( ), N * sizeof( int ) } } );
+            contents.push_back( { RLCP, { lcpLR.rightLcp( ), N * sizeof( int ) } } );
+        }
+
+        IndexHeader h{ };
+        memcpy( h.magic, MAGIC, sizeof( h.magic ) );
+        h.version = VERSION;
+        h.byteOrder = BYTE_ORDER_MARK;
+        h.textLength = N;
+        h.numSections = contents.size( );
+
+        vector<IndexSection> table( contents.size( ) );
+        uint64_t offset = alignUp( sizeof( IndexHeader ) + table.size( ) * sizeof( IndexSection ) );
+        for( int s = 0; s < table.size( ); ++s )
+        {
+            table[ s ].id = contents[ s ].first;
+            table[ s ].offset = offset;
+            table[ s ].bytes = contents[ s ].second.second;
+            table[ s ].checksum = checksum( contents[ s ].second.first, table[ s ].bytes );
+            offset = alignUp( offset + table[ s ].bytes );
+        }
+        h.headerChecksum = headerChecksum( h, table.data( ) );
+
+        writeFileAtomically( fileName, [ & ] ( std::ofstream & out )
+        {
+            out.write( reinterpret_cast<const char *>( &h ), sizeof( h ) );
+            out.write( reinterpret_cast<const char *>( table.data( ) ), table.size( ) * sizeof( IndexSection ) );
+            uint64_t written = sizeof( h ) + table.size( ) * sizeof( IndexSection );
+            for( int s = 0; s < table.size( ); ++s )
+            {
+                static const char zeros[ ALIGNMENT ] = { };
+                out.write( zeros, table[ s ].offset - written );
+                out.write( static_cast<const char *>( contents[ s ].second.first ), table[ s ].bytes );
+                written = table[ s ].offset + table[ s ].bytes;
+            }
+        } );
+    }
+
+    // True if every section matches its checksum
+    bool verify( ) const
+    {
+        for( int s = 0; s < header.numSections; ++s )
+        {
+            const IndexSection & section = sections( )[ s ];
+            if( checksum( file.data( ) + section.offset, section.bytes ) != section.checksum )
+                return false;
+        }
+        return true;
+    }
+
+    const unsigned char * text( ) const
+      { return file.data( ) + find( TEXT, header.textLength )->offset; }
+    const int * suffixArray( ) const
+      { return sectionInts( SA ); }
+    const int * lcp( ) const
+      { return sectionInts( LCP ); }
+    int size( ) const
+      { return header.textLength; }
+    bool hasLcpLR( ) const
+      { return find( LLCP, 0 ) != nullptr && find( RLCP, 0 ) != nullptr; }
+
+    // The index for queries, over the mapped arrays
+    const SuffixArrayIndex & queries( ) const
+      { return index; }
+
+  private:
+    struct IndexHeader
+    {
+        char magic[ 8 ];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t textLength;
+        uint32_t numSections;
+        uint32_t reserved;
+        uint64_t headerChecksum;    // Of the header, with this field 0, and the section table
+    };
+
+    struct IndexSection
+    {
+        uint32_t id;
+        uint32_t reserved;
+        uint64_t offset;            // From the start of the file
+        uint64_t bytes;
+        uint64_t checksum;
+    };
+
+    static constexpr const char *MAGIC = "SUFARRAY";
+    static const uint32_t VERSION = 1;
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static const int ALIGNMENT = 64;
+
+    MappedFile file;
+    IndexHeader header;
+    SuffixArrayIndex index;
+
+    static uint64_t alignUp( uint64_t offset )
+      { return ( offset + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT; }
+
+    static uint64_t headerChecksum( IndexHeader h, const IndexSection *table )
+    {
+        h.headerChecksum = 0;
+        vector<unsigned char> bytes( sizeof( h ) + h.numSections * sizeof( IndexSection ) );
+        memcpy( bytes.data( ), &h, sizeof( h ) );
+        memcpy( bytes.data( ) + sizeof( h ), table, h.numSections * sizeof( IndexSection ) );
+        return checksum( bytes.data( ), bytes.size( ) );
+    }
+
+    static IndexHeader readHeader( const MappedFile & file, const string & fileName )
+    {
+        IndexHeader h;
+        if( file.size( ) < sizeof( h ) )
+            throw invalid_argument{ fileName + " is not a suffix array index" };
+        memcpy( &h, file.data( ), sizeof( h ) );
+
+        if( memcmp( h.magic, MAGIC, sizeof( h.magic ) ) != 0 )
+            throw invalid_argument{ fileName + " is not a suffix array index" };
+        if( h.byteOrder != BYTE_ORDER_MARK )
+            throw invalid_argument{ fileName + " was written with another byte order" };
+        if( h.version != VERSION )
+            throw invalid_argument{ fileName + " has unsupported version " + std::to_string( h.version ) };
+
+        uint64_t tableEnd = sizeof( h ) + uint64_t( h.numSections ) * sizeof( IndexSection );
+        if( tableEnd > file.size( ) || h.textLength > 0x7fffffff )
+            throw invalid_argument{ fileName + " is corrupt" };
+        const IndexSection *table = reinterpret_cast<const IndexSection *>( file.data( ) + sizeof( h ) );
+        if( headerChecksum( h, table ) != h.headerChecksum )
+            throw invalid_argument{ fileName + " is corrupt (header checksum)" };
+
+        for( uint32_t s = 0; s < h.numSections; ++s )
+            if( table[ s ].offset % ALIGNMENT != 0 || table[ s ].offset > file.size( )
+                || table[ s ].bytes > file.size( ) - table[ s ].offset )
+                throw invalid_argument{ fileName + " is truncated" };
+        return h;
+    }
+
+    const IndexSection * sections( ) const
+      { return reinterpret_cast<const IndexSection *>( file.data( ) + sizeof( IndexHeader ) ); }
+
+    // The section with this id and size, or nullptr if there is none;
+    // a size of 0 accepts any size. Throws if a required section is missing
+    const IndexSection * find( SectionId id, uint64_t bytes ) const
+    {
+        for( int s = 0; s < header.numSections; ++s )
+            if( sections( )[ s ].id == id )
+            {
+                if( bytes != 0 && sections( )[ s ].bytes != bytes )
+                    throw invalid_argument{ "Suffix array index section " + std::to_string( id )
+                                            + " has the wrong size" };
+                return &sections( )[ s ];
+            }
+        if( id == LLCP || id == RLCP )
+            return nullptr;
+        throw invalid_argument{ "Suffix array index has no section " + std::to_string( id ) };
+    }
+
+    const int * sectionInts( SectionId id ) const
+      { return reinterpret_cast<const int *>( file.data( ) + find( id, header.textLength * sizeof( int ) )->offset ); }
+
+    SuffixArrayIndex makeIndex( ) const
+    {
+        if( hasLcpLR( ) )
+            return SuffixArrayIndex{ text( ), size( ), suffixArray( ),
+                                     sectionInts( LLCP ), sectionInts( RLCP ) };
+        return SuffixArrayIndex{ text( ), size( ), suffixArray( ), lcp( ) };
+    }
+};
+
 void printV( const vector<int> & a, const string & comment)
 {
     cout << comment << ":";
@@ -336,8 +1549,583 @@ void assert0( bool cond )
 }
 
 
-int main( )
+/*
+ * Return the contents of fileName
+ */
+string readFile( const string & fileName )
+{
+    ifstream in{ fileName, std::ios::binary };
+    if( !in )
+        throw invalid_argument{ "Cannot open " + fileName };
+
+    ostringstream contents;
+    contents << in.rdbuf( );
+    return contents.str( );
+}
+
+/*
+ * Compare the suffix arrays and LCP arrays of the three builders
+ * on random texts over several alphabet sizes
+ */
+void checkBuilders( )
+{
+    srand( 1 );
+    for( int alphabet : { 1, 2, 4, 26, 127 } )
+        for( int N = 2; N < 3000; N = N * 5 / 4 + 1 )
+        {
+            string text( N, ' ' );
+            for( char & ch : text )
+                ch = 1 + rand( ) % alphabet;
+
+            vector<int> sa1( N ), LCP1( N ), sa2( N ), LCP2( N ), sa3( N ), LCP3( N );
+            createSuffixArraySlow( text, sa1, LCP1 );
+            createSuffixArray( text, sa2, LCP2 );
+            createSuffixArray( text, sa3, LCP3, SuffixArrayAlgorithm::SAIS );
+
+            if( sa1 != sa2 || LCP1 != LCP2 )
+                cout << "OOPS!! DC3 on alphabet " << alphabet << ", N = " << N << endl;
+            if( sa1 != sa3 || LCP1 != LCP3 )
+                cout << "OOPS!! SA-IS on alphabet " << alphabet << ", N = " << N << endl;
+
+            for( int numThreads = 1; numThreads <= 4; numThreads *= 2 )
+            {
+                createSuffixArrayParallel( reinterpret_cast<const unsigned char *>( text.data( ) ),
+                                           N, sa2, numThreads );
+                if( sa1 != sa2 )
+                    cout << "OOPS!! parallel on alphabet " << alphabet << ", N = " << N << endl;
+            }
+        }
+    cout << "Finished checkBuilders" << endl;
+}
+
+/*
+ * Build the suffix and LCP arrays of text with each builder in
+ * turn, each in a child process so that its peak RSS is its own,
+ * and report seconds and peak RSS. The slow builder is skipped
+ * for texts over slowLimit characters.
+ */
+void benchmarkBuilders( const string & text, int slowLimit )
+{
+    const char *names[ ] = { "slow", "DC3", "SA-IS", "parallel" };
+    const SuffixArrayAlgorithm algorithms[ ] = { SuffixArrayAlgorithm::DC3, SuffixArrayAlgorithm::DC3,
+                                                 SuffixArrayAlgorithm::SAIS, SuffixArrayAlgorithm::PARALLEL };
+    int N = text.length( );
+
+    cout << "N = " << N << endl;
+    cout << "builder    seconds   peak RSS (MB)   bytes/char" << endl;
+    for( int builder = 0; builder < 4; ++builder )
+    {
+        if( builder == 0 && N > slowLimit )
+            continue;
+
+        cout.flush( );
+        pid_t child = fork( );
+        if( child == 0 )
+        {
+            auto start = std::chrono::steady_clock::now( );
+            vector<int> sa( N ), LCP( N );
+            if( builder == 0 )
+                createSuffixArraySlow( text, sa, LCP );
+            else
+                createSuffixArray( text, sa, LCP, algorithms[ builder ] );
+            double seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now( ) - start ).count( );
+
+            struct rusage usage;
+            getrusage( RUSAGE_SELF, &usage );
+            double megabytes = usage.ru_maxrss / 1024.0;
+            printf( "%-8s %9.3f %15.1f %12.2f\n", names[ builder ], seconds,
+                    megabytes, megabytes * 1048576 / N );
+            fflush( stdout );
+            _exit( 0 );
+        }
+        waitpid( child, nullptr, 0 );
+    }
+}
+
+/*
+ * Build the suffix array of the mapped file with the parallel
+ * builder at 1, 2, 4, ... threads, up to maxThreads, and check
+ * each result against SA-IS
+ */
+void buildMapped( const string & fileName, int maxThreads )
+{
+    MappedFile file{ fileName };
+    if( file.size( ) > 0x7fffffff )
+        throw invalid_argument{ fileName + " is too large for int indices" };
+    int N = file.size( );
+
+    vector<int> expected;
+    makeSuffixArraySAIS( file.data( ), N, expected );
+
+    cout << "N = " << N << endl;
+    cout << "threads   seconds" << endl;
+    for( int numThreads = 1; ; numThreads = std::min( 2 * numThreads, maxThreads ) )
+    {
+        vector<int> sa;
+        auto start = std::chrono::steady_clock::now( );
+        createSuffixArrayParallel( file.data( ), N, sa, numThreads );
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now( ) - start ).count( );
+
+        printf( "%7d %9.3f%s\n", numThreads, seconds, sa == expected ? "" : "  OOPS!!" );
+        if( numThreads == maxThreads )
+            break;
+    }
+}
+
+/*
+ * Compare count and locate, of SuffixArrayIndex and FMIndex, against
+ * a scan of the text, on random texts and on patterns both taken from
+ * the text and random
+ */
+void checkQueries( )
+{
+    srand( 2 );
+    for( int alphabet : { 2, 4, 26 } )
+        for( int N = 1; N < 5000; N = N * 3 + 1 )
+        {
+            string text( N, ' ' );
+            for( char & ch : text )
+                ch = 'a' + rand( ) % alphabet;
+
+            vector<int> sa( N ), LCP( N );
+            createSuffixArray( text, sa, LCP, SuffixArrayAlgorithm::SAIS );
+            SuffixArrayIndex index{ reinterpret_cast<const unsigned char *>( text.data( ) ),
+                                    N, sa.data( ), LCP.data( ) };
+
+            vector<string> patterns;
+            for( int q = 0; q < 200; ++q )
+            {
+                int len = rand( ) % 8;
+                int start = rand( ) % N;
+                patterns.push_back( q % 2 == 0 ? text.substr( start, len )
+                                               : string( len, 'a' + rand( ) % alphabet ) );
+            }
+
+            FMIndex fm{ reinterpret_cast<const unsigned char *>( text.data( ) ), N, sa.data( ), 4 };
+
+            vector<int> batchCounts( patterns.size( ) );
+            vector<vector<int>> batchPositions( patterns.size( ) );
+            index.batch( patterns, [ & ] ( int i, const int *positions, int numPositions, int count )
+                                     {
+                                         batchCounts[ i ] = count;
+                                         batchPositions[ i ].assign( positions, positions + numPositions );
+                                         sort( batchPositions[ i ].begin( ), batchPositions[ i ].end( ) );
+                                     }, 3 );
+
+            for( int q = 0; q < patterns.size( ); ++q )
+            {
+                vector<int> expected;
+                for( size_t pos = text.find( patterns[ q ] ); pos != string::npos && pos < N;
+                     pos = text.find( patterns[ q ], pos + 1 ) )
+                    expected.push_back( pos );
+
+                vector<int> found = index.locate( patterns[ q ] );
+                sort( found.begin( ), found.end( ) );
+                if( found != expected || index.count( patterns[ q ] ) != expected.size( )
+                    || batchCounts[ q ] != expected.size( )
+                    || batchPositions[ q ].size( ) != std::min<int>( 3, expected.size( ) )
+                    || !std::includes( expected.begin( ), expected.end( ),
+                                       batchPositions[ q ].begin( ), batchPositions[ q ].end( ) )
+                    || index.locateFirstK( patterns[ q ], 3 ).size( ) != std::min<int>( 3, expected.size( ) ) )
+                    cout << "OOPS!! query \"" << patterns[ q ] << "\", N = " << N << endl;
+
+                found = fm.locate( patterns[ q ] );
+                sort( found.begin( ), found.end( ) );
+                if( found != expected || fm.count( patterns[ q ] ) != expected.size( ) )
+                    cout << "OOPS!! FM-index query \"" << patterns[ q ] << "\", N = " << N << endl;
+            }
+        }
+    cout << "Finished checkQueries" << endl;
+}
+
+/*
+ * Answer the patterns, one per line of patternFile, against the
+ * mapped text file in one batch, and report queries per second
+ */
+void batchQueries( const string & fileName, const string & patternFile )
+{
+    MappedFile file{ fileName };
+    int N = file.size( );
+    vector<int> sa, LCP( N );
+    makeSuffixArraySAIS( file.data( ), N, sa );
+    makeLCPArray( file.data( ), N, sa, LCP );
+    SuffixArrayIndex index{ file.data( ), N, sa.data( ), LCP.data( ) };
+
+    vector<string> patterns;
+    ifstream in{ patternFile };
+    for( string line; getline( in, line ); )
+        patterns.push_back( line );
+
+    long long occurrences = 0;
+    auto start = std::chrono::steady_clock::now( );
+    index.batch( patterns, [ & ] ( int, const int *, int, int count )
+                             { occurrences += count; } );
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now( ) - start ).count( );
+
+    printf( "%d patterns, %lld occurrences, %.3f s, %.0f queries/s\n",
+            int( patterns.size( ) ), occurrences, seconds, patterns.size( ) / seconds );
+}
+
+/*
+ * Build the FM-index of the mapped file, report its size against
+ * the text, and time count on numPatterns substrings of the text
+ * of length patternLength, checking the counts with SuffixArrayIndex
+ */
+void benchmarkFMIndex( const string & fileName, int numPatterns, int patternLength )
+{
+    MappedFile file{ fileName };
+    int N = file.size( );
+    vector<int> sa, LCP( N );
+    makeSuffixArraySAIS( file.data( ), N, sa );
+    makeLCPArray( file.data( ), N, sa, LCP );
+    SuffixArrayIndex index{ file.data( ), N, sa.data( ), LCP.data( ) };
+    FMIndex fm{ file.data( ), N, sa.data( ) };
+
+    printf( "N = %d; FM-index %.3f bytes/char for count, %.3f with locate\n",
+            N, double( fm.countSizeInBytes( ) ) / N, double( fm.sizeInBytes( ) ) / N );
+
+    vector<string> patterns;
+    srand( 3 );
+    for( int i = 0; i < numPatterns && N > patternLength; ++i )
+        patterns.push_back( string( reinterpret_cast<const char *>( file.data( ) )
+                                    + rand( ) % ( N - patternLength ), patternLength ) );
+
+    long long total = 0;
+    auto start = std::chrono::steady_clock::now( );
+    for( const string & p : patterns )
+        total += fm.count( p );
+    double fmSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+
+    start = std::chrono::steady_clock::now( );
+    for( const string & p : patterns )
+        total -= index.count( p );
+    double saSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+
+    int located = 0;
+    start = std::chrono::steady_clock::now( );
+    for( int i = 0; i < patterns.size( ) && i < 1000; ++i )
+        located += fm.locate( patterns[ i ], 10 ).size( );
+    double locateSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+
+    printf( "count: FM-index %.2f us, suffix array %.2f us per pattern of length %d%s\n",
+            1e6 * fmSeconds / patterns.size( ), 1e6 * saSeconds / patterns.size( ),
+            patternLength, total == 0 ? "" : "  OOPS!! counts differ" );
+    printf( "locate: %.2f us per position\n", 1e6 * locateSeconds / std::max( located, 1 ) );
+}
+
+/*
+ * Save indexes of random texts, with and without the LCP-lr
+ * sections, open them, and compare their answers with an index
+ * built in memory; then check that corruption is caught
+ */
+void checkIndexFile( )
+{
+    const string fileName = "SuffixArray-check-" + std::to_string( getpid( ) ) + ".idx";
+    srand( 4 );
+    for( int N : { 0, 1, 7, 1000, 20000 } )
+        for( bool withLcpLR : { true, false } )
+        {
+            string text( N, ' ' );
+            for( char & ch : text )
+                ch = 'a' + rand( ) % 3;
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>( text.data( ) );
+
+            vector<int> sa( N ), LCP( N );
+            createSuffixArray( text, sa, LCP, SuffixArrayAlgorithm::SAIS );
+            SuffixArrayIndex expected{ bytes, N, sa.data( ), LCP.data( ) };
+            SuffixArrayFile::write( fileName, bytes, N, sa.data( ), LCP.data( ), withLcpLR );
+
+            SuffixArrayFile saved{ fileName };
+            if( saved.size( ) != N || saved.hasLcpLR( ) != withLcpLR || !saved.verify( )
+                || memcmp( saved.text( ), bytes, N ) != 0
+                || !std::equal( sa.begin( ), sa.end( ), saved.suffixArray( ) )
+                || !std::equal( LCP.begin( ), LCP.end( ), saved.lcp( ) ) )
+                cout << "OOPS!! saved index, N = " << N << endl;
+
+            for( int q = 0; q < 100 && N > 0; ++q )
+            {
+                string pattern = text.substr( rand( ) % N, rand( ) % 6 );
+                if( saved.queries( ).locate( pattern ) != expected.locate( pattern ) )
+                    cout << "OOPS!! saved index query \"" << pattern << "\", N = " << N << endl;
+            }
+        }
+
+        // Flip a byte of the suffix array, then truncate the file
+    {
+        std::fstream f{ fileName, std::ios::in | std::ios::out | std::ios::binary };
+        f.seekp( -5, std::ios::end );
+        f.put( 0x7f );
+    }
+    if( SuffixArrayFile{ fileName }.verify( ) )
+        cout << "OOPS!! corrupt section not detected" << endl;
+    if( truncate( fileName.c_str( ), 1000 ) != 0 )
+        cout << "OOPS!! cannot truncate " << fileName << endl;
+    try
+    {
+        SuffixArrayFile truncated{ fileName };
+        cout << "OOPS!! truncated index opened" << endl;
+    }
+    catch( const invalid_argument & e )
+    {
+    }
+    remove( fileName.c_str( ) );
+    cout << "Finished checkIndexFile" << endl;
+}
+
+/*
+ * Build the index of the mapped file and save it to indexFile
+ */
+void saveIndex( const string & fileName, const string & indexFile, bool withLcpLR )
+{
+    MappedFile file{ fileName };
+    if( file.size( ) > 0x7fffffff )
+        throw invalid_argument{ fileName + " is too large for int indices" };
+    int N = file.size( );
+
+    auto start = std::chrono::steady_clock::now( );
+    vector<int> sa, LCP( N );
+    makeSuffixArraySAIS( file.data( ), N, sa );
+    makeLCPArray( file.data( ), N, sa, LCP );
+    SuffixArrayFile::write( indexFile, file.data( ), N, sa.data( ), LCP.data( ), withLcpLR );
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now( ) - start ).count( );
+
+    printf( "N = %d; built and saved %s in %.3f s\n", N, indexFile.c_str( ), seconds );
+}
+
+/*
+ * Open a saved index, time the open (and the checksums, if the
+ * first pattern is "verify"), and count each pattern
+ */
+void openIndex( const string & indexFile, vector<string> patterns )
+{
+    auto start = std::chrono::steady_clock::now( );
+    SuffixArrayFile saved{ indexFile };
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now( ) - start ).count( );
+    printf( "N = %d; opened in %.3f ms%s\n", saved.size( ), 1e3 * seconds,
+            saved.hasLcpLR( ) ? "" : " (LCP-lr rebuilt)" );
+
+    if( !patterns.empty( ) && patterns[ 0 ] == "verify" )
+    {
+        patterns.erase( patterns.begin( ) );
+        start = std::chrono::steady_clock::now( );
+        bool ok = saved.verify( );
+        seconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+        printf( "checksums %s in %.3f s\n", ok ? "match" : "DO NOT MATCH", seconds );
+    }
+
+    for( const string & pattern : patterns )
+    {
+        cout << pattern << ": " << saved.queries( ).count( pattern ) << " occurrences;";
+        for( int pos : saved.queries( ).locateFirstK( pattern, 10 ) )
+            cout << " " << pos;
+        cout << endl;
+    }
+}
+
+/*
+ * Compare lce and mismatches against character-by-character
+ * comparison on random texts
+ */
+void checkLce( )
+{
+    srand( 5 );
+    for( int alphabet : { 1, 2, 4 } )
+        for( int N = 1; N < 5000; N = N * 3 + 1 )
+        {
+            string text( N, ' ' );
+            for( char & ch : text )
+                ch = 'a' + rand( ) % alphabet;
+
+            vector<int> sa( N ), LCP( N );
+            createSuffixArray( text, sa, LCP, SuffixArrayAlgorithm::SAIS );
+            LceIndex index{ sa.data( ), LCP.data( ), N };
+
+            for( int q = 0; q < 500; ++q )
+            {
+                int i = rand( ) % N, j = rand( ) % N;
+                if( index.lce( i, j ) != computeLCP( text.substr( i ), text.substr( j ) ) )
+                    cout << "OOPS!! lce( " << i << ", " << j << " ), N = " << N << endl;
+
+                int length = N - std::max( i, j );
+                int expected = 0;
+                for( int k = 0; k < length; ++k )
+                    expected += text[ i + k ] != text[ j + k ];
+                if( index.mismatches( i, j, length, 3 ) != std::min( expected, 4 ) )
+                    cout << "OOPS!! mismatches( " << i << ", " << j << " ), N = " << N << endl;
+            }
+        }
+    cout << "Finished checkLce" << endl;
+}
+
+/*
+ * Time lce on random pairs of positions of the mapped file against
+ * comparing characters, then find the approximate occurrences (at
+ * most maxMismatches mismatches) of a substring of the file at
+ * every position of the file
+ */
+void benchmarkLce( const string & fileName, int numQueries, int maxMismatches )
 {
+    MappedFile file{ fileName };
+    int N = file.size( );
+    const unsigned char *text = file.data( );
+    if( N < 2 )
+        return;
+    vector<int> sa, LCP( N );
+    makeSuffixArraySAIS( text, N, sa );
+    makeLCPArray( text, N, sa, LCP );
+
+    auto start = std::chrono::steady_clock::now( );
+    LceIndex index{ sa.data( ), LCP.data( ), N };
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+    printf( "N = %d; built in %.3f s, %.2f bytes/char\n", N, seconds, double( index.sizeInBytes( ) ) / N );
+
+        // A random pair almost never shares more than a few characters,
+        // so pick half the pairs from adjacent suffixes, which share more
+    vector<std::pair<int, int>> pairs( numQueries );
+    srand( 6 );
+    for( int q = 0; q < numQueries; ++q )
+    {
+        int r = rand( ) % ( N - 1 );
+        pairs[ q ] = q % 2 == 0 ? std::make_pair( rand( ) % N, rand( ) % N )
+                                : std::make_pair( sa[ r ], sa[ r + 1 ] );
+    }
+
+    long long total = 0;
+    start = std::chrono::steady_clock::now( );
+    for( const std::pair<int, int> & p : pairs )
+        total += index.lce( p.first, p.second );
+    double lceSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+    long long lceLength = total;
+
+    start = std::chrono::steady_clock::now( );
+    for( const std::pair<int, int> & p : pairs )
+    {
+        int k = 0;
+        if( p.first == p.second )
+            k = N - p.first;
+        else
+            while( p.first + k < N && p.second + k < N && text[ p.first + k ] == text[ p.second + k ] )
+                ++k;
+        total -= k;
+    }
+    double scanSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+
+    printf( "lce: average length %.1f; %.1f ns per query, comparing characters %.1f ns%s\n",
+            double( lceLength ) / numQueries, 1e9 * lceSeconds / numQueries, 1e9 * scanSeconds / numQueries,
+            total == 0 ? "" : "  OOPS!! lengths differ" );
+
+    const int LENGTH = std::min( 32, N );
+    int source = rand( ) % ( N - LENGTH + 1 );
+    int found = 0;
+    start = std::chrono::steady_clock::now( );
+    for( int p = 0; p + LENGTH <= N; ++p )
+        found += index.mismatches( source, p, LENGTH, maxMismatches ) <= maxMismatches;
+    seconds = std::chrono::duration<double>( std::chrono::steady_clock::now( ) - start ).count( );
+    printf( "%d occurrences of text[%d..%d] with at most %d mismatches, %.3f s\n",
+            found, source, source + LENGTH - 1, maxMismatches, seconds );
+}
+
+/*
+ * Usage: SuffixArray                     (prints the arrays for banana)
+ *        SuffixArray check               (compares the builders)
+ *        SuffixArray bench file [slowLimit]
+ *              (time and peak memory of each builder on file; the
+ *               slow builder only runs if the file has at most
+ *               slowLimit characters, default 10,000,000)
+ *        SuffixArray build file [threads]
+ *              (time the parallel builder on the memory-mapped file
+ *               at 1, 2, 4, ... threads, default all cores)
+ *        SuffixArray query file pattern ...
+ *              (count and the first 10 positions of each pattern)
+ *        SuffixArray batch file patternFile
+ *              (answer the patterns, one per line, in one batch)
+ *        SuffixArray fm file [numPatterns [patternLength]]
+ *              (FM-index size, and time per count and locate, on
+ *               substrings of the file, default 100,000 of length 8)
+ *        SuffixArray lce file [numQueries [maxMismatches]]
+ *              (time of lce on random pairs, default 1,000,000,
+ *               and a scan for approximate repeats of a substring
+ *               with up to maxMismatches mismatches, default 2)
+ *        SuffixArray save file indexFile [nolcplr]
+ *              (build the index of file and write it to indexFile)
+ *        SuffixArray open indexFile [verify] [pattern ...]
+ *              (map indexFile, optionally check its checksums, and
+ *               count each pattern)
+ */
+int main( int argc, char *argv[ ] )
+{
+    string mode = argc > 1 ? argv[ 1 ] : "";
+
+    if( mode == "check" )
+    {
+        checkBuilders( );
+        checkQueries( );
+        checkIndexFile( );
+        checkLce( );
+        return 0;
+    }
+    if( mode == "query" && argc > 2 )
+    {
+        string text = readFile( argv[ 2 ] );
+        int N = text.length( );
+        vector<int> sa( N ), LCP( N );
+        createSuffixArray( text, sa, LCP, SuffixArrayAlgorithm::SAIS );
+        SuffixArrayIndex index{ reinterpret_cast<const unsigned char *>( text.data( ) ),
+                                N, sa.data( ), LCP.data( ) };
+
+        for( int i = 3; i < argc; ++i )
+        {
+            cout << argv[ i ] << ": " << index.count( argv[ i ] ) << " occurrences;";
+            for( int pos : index.locateFirstK( argv[ i ], 10 ) )
+                cout << " " << pos;
+            cout << endl;
+        }
+        return 0;
+    }
+    if( mode == "lce" && argc > 2 )
+    {
+        benchmarkLce( argv[ 2 ], argc > 3 ? atoi( argv[ 3 ] ) : 1000000,
+                      argc > 4 ? atoi( argv[ 4 ] ) : 2 );
+        return 0;
+    }
+    if( mode == "save" && argc > 3 )
+    {
+        saveIndex( argv[ 2 ], argv[ 3 ], !( argc > 4 && string( argv[ 4 ] ) == "nolcplr" ) );
+        return 0;
+    }
+    if( mode == "open" && argc > 2 )
+    {
+        openIndex( argv[ 2 ], vector<string>( argv + 3, argv + argc ) );
+        return 0;
+    }
+    if( mode == "fm" && argc > 2 )
+    {
+        benchmarkFMIndex( argv[ 2 ], argc > 3 ? atoi( argv[ 3 ] ) : 100000,
+                          argc > 4 ? atoi( argv[ 4 ] ) : 8 );
+        return 0;
+    }
+    if( mode == "batch" && argc > 3 )
+    {
+        batchQueries( argv[ 2 ], argv[ 3 ] );
+        return 0;
+    }
+    if( mode == "build" && argc > 2 )
+    {
+        int maxThreads = argc > 3 ? atoi( argv[ 3 ] ) : std::thread::hardware_concurrency( );
+        buildMapped( argv[ 2 ], std::max( 1, maxThreads ) );
+        return 0;
+    }
+    if( mode == "bench" && argc > 2 )
+    {
+        benchmarkBuilders( readFile( argv[ 2 ] ), argc > 3 ? atoi( argv[ 3 ] ) : 10000000 );
+        return 0;
+    }
+
     const string abr = "banana";
     vector<int> sufarr( abr.length( ) );
     vector<int> LCP( abr.length( ) );
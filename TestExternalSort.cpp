@@ -0,0 +1,102 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include "ExternalSort.h"
+#include "UniformRandom.h"
+using namespace std;
+
+const int RECORD_SIZE = 100;
+const int KEY_OFFSET = 4;
+const int KEY_LENGTH = 10;
+
+/**
+ * Write n random records to fileName; return them.
+ * Keys are drawn from a small alphabet so that there are duplicates.
+ */
+vector<string> writeRecords( const string & fileName, int n )
+{
+    static UniformRandom r;
+    vector<string> records( n, string( RECORD_SIZE, ' ' ) );
+    ofstream out{ fileName, ios::binary };
+
+    for( string & rec : records )
+    {
+        for( char & c : rec )
+            c = 'a' + r.nextInt( 26 );
+        for( int i = KEY_OFFSET; i < KEY_OFFSET + KEY_LENGTH; ++i )
+            rec[ i ] = i < KEY_OFFSET + 3 ? 'a' + r.nextInt( 4 ) : char( r.nextInt( 256 ) );
+        out.write( rec.data( ), RECORD_SIZE );
+    }
+
+    return records;
+}
+
+/**
+ * Check that fileName holds a sorted permutation of records.
+ */
+void checkOutput( const string & fileName, vector<string> records, const string & test )
+{
+    ifstream in{ fileName, ios::binary };
+    vector<string> sorted;
+    string rec( RECORD_SIZE, ' ' );
+
+    while( in.read( &rec[ 0 ], RECORD_SIZE ) )
+        sorted.push_back( rec );
+
+    for( int i = 1; i < sorted.size( ); ++i )
+        if( sorted[ i ].compare( KEY_OFFSET, KEY_LENGTH, sorted[ i - 1 ], KEY_OFFSET, KEY_LENGTH ) < 0 )
+        {
+            cout << test << ": OOPS!! out of order at " << i << endl;
+            return;
+        }
+
+    std::sort( begin( records ), end( records ) );
+    std::sort( begin( sorted ), end( sorted ) );
+    if( sorted != records )
+        cout << test << ": OOPS!! records lost or changed" << endl;
+    else
+        cout << test << ": OK" << endl;
+}
+
+void runTest( const string & test, int n, long long memoryBytes, int fanIn )
+{
+    vector<string> records = writeRecords( "extsort-test.in", n );
+    ExternalSortOptions options{ RECORD_SIZE };
+    options.keyOffset = KEY_OFFSET;
+    options.keyLength = KEY_LENGTH;
+    options.memoryBytes = memoryBytes;
+    options.maxFanIn = fanIn;
+
+    ExternalSortStats stats = externalSort( "extsort-test.in", "extsort-test.out", options );
+    cout << "  " << stats.runs << " runs, " << stats.mergePasses << " merge passes" << endl;
+    checkOutput( "extsort-test.out", records, test );
+}
+
+int main( )
+{
+    runTest( "empty file", 0, 1 << 20, 4 );
+    runTest( "one run", 5000, 16 << 20, 4 );
+    runTest( "one merge", 50000, 1 << 20, 64 );
+    runTest( "several merge passes", 200000, 1 << 20, 4 );
+
+    ofstream bad{ "extsort-test.in", ios::binary };
+    bad << "not a whole record";
+    bad.close( );
+    try
+    {
+        externalSort( "extsort-test.in", "extsort-test.out", ExternalSortOptions{ RECORD_SIZE } );
+        cout << "OOPS!! partial record was accepted" << endl;
+    }
+    catch( const invalid_argument & e )
+    {
+        cout << "partial record: OK (" << e.what( ) << ")" << endl;
+    }
+
+    remove( "extsort-test.in" );
+    remove( "extsort-test.out" );
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 #include "UniformRandom.h"
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 
@@ -25,6 +27,431 @@ void permute( vector<AnyType> & a )
 }
 
 
+/**
+ * Fill a with n items in one of several distributions that
+ * defeat textbook quicksorts. Returns the distribution's name.
+ */
+string makeDistribution( vector<int> & a, int n, int kind )
+{
+    static UniformRandom r;
+    a.resize( n );
+
+    switch( kind )
+    {
+      case 0:
+        for( int i = 0; i < n; ++i )
+            a[ i ] = r.nextInt( );
+        return "random";
+      case 1:
+        for( int i = 0; i < n; ++i )
+            a[ i ] = i;
+        return "sorted";
+      case 2:
+        for( int i = 0; i < n; ++i )
+            a[ i ] = n - i;
+        return "reverse sorted";
+      case 3:
+        for( int i = 0; i < n; ++i )
+            a[ i ] = 42;
+        return "all equal";
+      case 4:
+        for( int i = 0; i < n; ++i )
+            a[ i ] = r.nextInt( 0, 15 );
+        return "many duplicates";
+      case 5:
+        for( int i = 0; i < n; ++i )
+            a[ i ] = i < n / 2 ? i : n - i;
+        return "organ pipe";
+      case 6:
+        for( int i = 0; i < n; ++i )
+            a[ i ] = i % 1000;
+        return "sawtooth";
+      case 7:
+        for( int i = 0; i < n; ++i )
+            a[ i ] = i;
+        for( int i = 0; i < n / 100; ++i )
+            swap( a[ r.nextInt( 0, n - 1 ) ], a[ r.nextInt( 0, n - 1 ) ] );
+        return "nearly sorted";
+      default:
+        for( int i = 0; i < n; ++i )
+            a[ i ] = ( i % 2 == 0 ) ? i : n - i;
+        return "interleaved";
+    }
+}
+
+void checkAdversarial( int n )
+{
+    for( int kind = 0; kind <= 8; ++kind )
+    {
+        vector<int> a;
+        string name = makeDistribution( a, n, kind );
+        vector<int> expected = a;
+
+        std::sort( begin( expected ), end( expected ) );
+        vector<int> b = a;
+
+        SORT( a );
+        if( a != expected )
+            cout << "OOPS!! SORT failed on " << name << endl;
+
+        quicksort( b );     // blockPartition, since int is arithmetic
+        if( b != expected )
+            cout << "OOPS!! quicksort failed on " << name << endl;
+    }
+}
+
+/**
+ * Check multiSelect, introSelect, and partialSort against a full
+ * sort, on the adversarial distributions. Also runs the selection
+ * with no median-of-three levels, so that every pivot is a median
+ * of medians.
+ */
+void checkSelection( int n )
+{
+    for( int kind = 0; kind <= 8; ++kind )
+    {
+        vector<int> a;
+        string name = makeDistribution( a, n, kind );
+        vector<int> expected = a;
+        std::sort( begin( expected ), end( expected ) );
+
+        vector<int> ranks{ n / 2, n * 9 / 10, n * 99 / 100, n * 999 / 1000, 1, n, n / 2 };
+        for( int depthLimit : { selectDepthLimit( n ), 0 } )
+        {
+            vector<int> b = a;
+            vector<int> sorted = ranks;
+            std::sort( begin( sorted ), end( sorted ) );
+            sorted.erase( std::unique( begin( sorted ), end( sorted ) ), end( sorted ) );
+            multiSelect( b, 0, n - 1, sorted, 0, sorted.size( ), depthLimit );
+            for( int r : ranks )
+                if( b[ r - 1 ] != expected[ r - 1 ] )
+                    cout << "OOPS!! multiSelect failed on " << name << ", depth " << depthLimit << endl;
+        }
+
+        vector<int> b = a;
+        introSelect( b, n / 3 );
+        for( int i = 0; i < n; ++i )
+            if( ( i < n / 3 - 1 && b[ n / 3 - 1 ] < b[ i ] )
+                || ( i >= n / 3 && b[ i ] < b[ n / 3 - 1 ] ) )
+            {
+                cout << "OOPS!! introSelect failed on " << name << endl;
+                break;
+            }
+
+        for( int k : { 0, 1, 17, 1000, n } )
+        {
+            b = a;
+            partialSort( b, k );
+            if( !std::equal( begin( b ), begin( b ) + k, begin( expected ) ) )
+                cout << "OOPS!! partialSort failed on " << name << ", k = " << k << endl;
+        }
+    }
+}
+
+/**
+ * Check quicksort, mergeSort, and quickSelect on primitive keys,
+ * whose small subarrays go through the sorting networks, and the
+ * heapsorts, whose D-ary heaps are placed on cache lines.
+ */
+template <typename Number>
+void checkPrimitiveSorts( const string & name )
+{
+    static UniformRandom r;
+
+    for( int n = 0; n <= 1000; n += ( n < 70 ? 1 : 97 ) )
+    {
+        vector<Number> a( n );
+        for( Number & x : a )
+            x = static_cast<Number>( r.nextInt( -n, n ) ) / 2;
+
+        vector<Number> expected = a;
+        std::sort( begin( expected ), end( expected ) );
+
+        vector<Number> b = a;
+        quicksort( b );
+        if( b != expected )
+            cout << "OOPS!! quicksort failed on " << name << " " << n << endl;
+
+        b = a;
+        mergeSort( b );
+        if( b != expected )
+            cout << "OOPS!! mergeSort failed on " << name << " " << n << endl;
+
+        b = a;
+        bottomUpHeapsort( b );
+        if( b != expected )
+            cout << "OOPS!! bottomUpHeapsort failed on " << name << " " << n << endl;
+
+        b = a;
+        dAryHeapsort<4>( b );
+        if( b != expected )
+            cout << "OOPS!! dAryHeapsort<4> failed on " << name << " " << n << endl;
+
+        b = a;
+        dAryHeapsort<8>( b );
+        if( b != expected )
+            cout << "OOPS!! dAryHeapsort<8> failed on " << name << " " << n << endl;
+
+        for( int k = 1; k <= n; k += 1 + n / 7 )
+        {
+            b = a;
+            quickSelect( b, k );
+            if( b[ k - 1 ] != expected[ k - 1 ] )
+                cout << "OOPS!! quickSelect failed on " << name << " " << n << endl;
+        }
+    }
+}
+
+/**
+ * Return the number of negative zeros in a.
+ */
+template <typename Number>
+int negativeZeros( const vector<Number> & a )
+{
+    int count = 0;
+    for( Number x : a )
+        count += x == 0 && signbit( x );
+    return count;
+}
+
+/**
+ * Check that the sorting networks, and the sorts that use them,
+ * permute keys that compare equal but differ: -0.0 and +0.0
+ * must both survive, in any order.
+ */
+template <typename Number>
+void checkSignedZeros( const string & name )
+{
+    static UniformRandom r;
+
+    vector<Number> fixed = { 0.0, -0.0, 1.0, -0.0, 0.0, 2.0, -1.0, 0.0 };
+    for( int n = 0; n <= 200; n += ( n < 70 ? 1 : 13 ) )
+    {
+        vector<Number> a = n == 0 ? fixed : vector<Number>( n );
+        if( n > 0 )
+            for( Number & x : a )
+                x = r.nextInt( 3 ) == 0 ? static_cast<Number>( r.nextInt( -2, 2 ) )
+                                        : ( r.nextInt( 2 ) == 0 ? Number( -0.0 ) : Number( 0.0 ) );
+
+        auto check = [ & ] ( const vector<Number> & b, const string & sortName )
+        {
+            if( !std::is_sorted( begin( b ), end( b ) ) || negativeZeros( b ) != negativeZeros( a ) )
+                cout << "OOPS!! " << sortName << " lost a signed zero on " << name << " " << n << endl;
+        };
+
+        vector<Number> b = a;
+        if( b.size( ) <= NETWORK_CUTOFF )
+        {
+            networkSort( b.data( ), b.size( ) );
+            check( b, "networkSort" );
+
+            int size = 32;
+            vector<Number> v( size, networkPadding<Number>( ) );
+            std::copy( begin( a ), end( a ), begin( v ) );
+            bitonicNetwork( v.data( ), size );
+            v.resize( a.size( ) );
+            check( v, "bitonicNetwork" );
+        }
+
+        b = a;
+        quicksort( b );
+        check( b, "quicksort" );
+        b = a;
+        mergeSort( b );
+        check( b, "mergeSort" );
+    }
+}
+
+/**
+ * A record keyed by an int, to check that radixSort is stable.
+ */
+struct KeyedRecord
+{
+    int key;
+    int original;
+
+    bool operator< ( const KeyedRecord & rhs ) const
+      { return key < rhs.key; }
+};
+
+/**
+ * Return true if records are sorted by key, with equal
+ * keys in their original order.
+ */
+bool isStablySorted( const vector<KeyedRecord> & records )
+{
+    for( int i = 1; i < records.size( ); ++i )
+        if( records[ i ].key < records[ i - 1 ].key
+            || ( records[ i ].key == records[ i - 1 ].key
+                 && records[ i ].original < records[ i - 1 ].original ) )
+            return false;
+    return true;
+}
+
+/**
+ * Check radixSort on signed, unsigned, and floating-point keys,
+ * and on records sorted by a key member.
+ */
+void checkRadixSort( int n )
+{
+    static UniformRandom r;
+
+    vector<int> ints( n );
+    for( int & x : ints )
+        x = r.nextInt( );
+    vector<unsigned long long> longs( n );
+    for( unsigned long long & x : longs )
+        x = ( static_cast<unsigned long long>( r.nextInt( ) ) << 8 ) ^ r.nextInt( 256 );
+    vector<double> doubles( n );
+    for( double & x : doubles )
+        x = ( r.nextDouble( ) - 0.5 ) * 1e6;
+    doubles[ 0 ] = -0.0;
+    vector<short> shorts( n );
+    for( short & x : shorts )
+        x = r.nextInt( -30000, 30000 );
+
+    vector<int> expectedInts = ints;
+    std::sort( begin( expectedInts ), end( expectedInts ) );
+    vector<unsigned long long> expectedLongs = longs;
+    std::sort( begin( expectedLongs ), end( expectedLongs ) );
+    vector<double> expectedDoubles = doubles;
+    std::sort( begin( expectedDoubles ), end( expectedDoubles ) );
+    vector<short> expectedShorts = shorts;
+    std::sort( begin( expectedShorts ), end( expectedShorts ) );
+
+    for( int digitBits = 8; digitBits <= 16; digitBits += digitBits == 8 ? 3 : 5 )
+    {
+        vector<int> a = ints;
+        radixSort( a, IdentityKey{ }, digitBits );
+        if( a != expectedInts )
+            cout << "OOPS!! radixSort failed on int, " << digitBits << " bits" << endl;
+    }
+    for( int digitBits : { 32, 64, 100 } )
+    {
+        vector<unsigned long long> a = longs;
+        radixSort( a, IdentityKey{ }, digitBits );
+        if( a != expectedLongs )
+            cout << "OOPS!! radixSort failed on unsigned long long, " << digitBits << " bits" << endl;
+    }
+
+    radixSort( longs );
+    if( longs != expectedLongs )
+        cout << "OOPS!! radixSort failed on unsigned long long" << endl;
+    radixSort( doubles );
+    if( doubles != expectedDoubles )
+        cout << "OOPS!! radixSort failed on double" << endl;
+    radixSort( shorts );
+    if( shorts != expectedShorts )
+        cout << "OOPS!! radixSort failed on short" << endl;
+
+    vector<KeyedRecord> records( n );
+    for( int i = 0; i < n; ++i )
+        records[ i ] = KeyedRecord{ r.nextInt( -100, 100 ), i };
+    radixSort( records, [ ] ( const KeyedRecord & rec ) { return rec.key; } );
+    if( !isStablySorted( records ) )
+        cout << "OOPS!! radixSort is not stable" << endl;
+}
+
+/**
+ * A record that counts how often it is moved, to check that
+ * applyPermutation moves each record once.
+ */
+struct CountedRecord
+{
+    static long long moves;
+    int key;
+
+    CountedRecord( int k = 0 ) : key{ k } { }
+    CountedRecord( CountedRecord && rhs ) : key{ rhs.key } { ++moves; }
+    CountedRecord & operator= ( CountedRecord && rhs )
+      { key = rhs.key; ++moves; return *this; }
+};
+
+long long CountedRecord::moves = 0;
+
+/**
+ * Check sortIndices and sortByKey on packed (int, float) and
+ * general (string) keys, and the move count of applyPermutation.
+ */
+void checkIndexSorts( int n )
+{
+    static UniformRandom r;
+
+    vector<KeyedRecord> records( n );
+    for( int i = 0; i < n; ++i )
+        records[ i ] = KeyedRecord{ r.nextInt( -1000, 1000 ), i };
+
+    vector<int> order = sortIndices( records, [ ] ( const KeyedRecord & rec ) { return rec.key; } );
+    vector<KeyedRecord> gathered;
+    for( int i : order )
+        gathered.push_back( records[ i ] );
+    if( !isStablySorted( gathered ) )
+        cout << "OOPS!! sortIndices failed on int keys" << endl;
+
+    vector<KeyedRecord> copy = records;
+    sortByKey( copy, [ ] ( const KeyedRecord & rec ) { return float( rec.key ) / 8; } );
+    if( !isStablySorted( copy ) )
+        cout << "OOPS!! sortByKey failed on float keys" << endl;
+
+    copy = records;
+    sortByKey( copy, [ ] ( const KeyedRecord & rec ) { return to_string( rec.key + 5000 ); } );
+    if( !isStablySorted( copy ) )
+        cout << "OOPS!! sortByKey failed on string keys" << endl;
+
+    vector<CountedRecord> counted;
+    for( int i = 0; i < n; ++i )
+        counted.emplace_back( i );
+    permute( order );
+    CountedRecord::moves = 0;
+    applyPermutation( counted, order );
+    for( int i = 0; i < n; ++i )
+        if( counted[ i ].key != order[ i ] )
+        {
+            cout << "OOPS!! applyPermutation failed at " << i << endl;
+            break;
+        }
+    if( CountedRecord::moves > n + n / 2 )
+        cout << "OOPS!! applyPermutation made " << CountedRecord::moves << " moves" << endl;
+}
+
+/**
+ * Check bottom-up mergesort, with one MergeSortArena shared by
+ * arrays of many sizes, and timSort, on random and on nearly
+ * sorted records.
+ */
+void checkStableSorts( )
+{
+    static UniformRandom r;
+    MergeSortArena<KeyedRecord> arena;
+
+    for( int n = 0; n < 50000; n = n * 3 / 2 + 1 )
+        for( int kind = 0; kind < 5; ++kind )
+        {
+            vector<KeyedRecord> records( n );
+            for( int i = 0; i < n; ++i )
+                if( kind == 0 )
+                    records[ i ] = KeyedRecord{ r.nextInt( 0, 50 ), i };
+                else if( kind == 1 )     // ascending with a few strays
+                    records[ i ] = KeyedRecord{ r.nextInt( 0, 30 ) == 0 ? r.nextInt( 0, n ) : i / 3, i };
+                else if( kind == 2 )     // several sorted batches
+                    records[ i ] = KeyedRecord{ i % 700, i };
+                else if( kind == 3 )     // descending with duplicates
+                    records[ i ] = KeyedRecord{ ( n - i ) / 4, i };
+                else                     // sorted batches, some descending
+                    records[ i ] = KeyedRecord{ ( i / 300 ) % 2 ? -( i % 300 ) : i % 300, i };
+
+            vector<KeyedRecord> copy = records;
+            arena.sort( records );
+            if( !isStablySorted( records ) )
+                cout << "OOPS!! MergeSortArena failed on " << n << endl;
+
+            timSort( copy );
+            if( !isStablySorted( copy ) )
+                cout << "OOPS!! timSort failed on " << n << " kind " << kind << endl;
+        }
+}
+
+
 int main( )
 {
     const int NUM_ITEMS = 1000;
@@ -47,6 +474,14 @@ int main( )
         heapsort( a );
         checkSort( a );
 
+        permute( a );
+        bottomUpHeapsort( a );
+        checkSort( a );
+
+        permute( a );
+        dAryHeapsort<4>( a );
+        checkSort( a );
+
         permute( a );
         shellsort( a );
         checkSort( a );
@@ -63,9 +498,31 @@ int main( )
         SORT( a );
         checkSort( a );
 
+        permute( a );
+        mergeSortBottomUp( a );
+        checkSort( a );
+
+        permute( a );
+        timSort( a );
+        checkSort( a );
+
+        permute( a );
+        parallelQuicksort( a, 4 );
+        checkSort( a );
+
+        permute( a );
+        parallelMergeSort( a, 4 );
+        checkSort( a );
+
         permute( a );
         quickSelect( a, NUM_ITEMS / 2 );
         cout << a[ NUM_ITEMS / 2 - 1 ].length( ) << " " << NUM_ITEMS / 2 << endl;
+
+        permute( a );
+        multiSelect( a, { NUM_ITEMS / 10, NUM_ITEMS / 2, NUM_ITEMS * 9 / 10 } );
+        if( a[ NUM_ITEMS / 2 - 1 ].length( ) != NUM_ITEMS / 2 - 1
+            || a[ NUM_ITEMS * 9 / 10 - 1 ].length( ) != NUM_ITEMS * 9 / 10 - 1 )
+            cout << "OOPS!! multiSelect failed" << endl;
     }
 
     cout << "Checking SORT, Fig 7.13" << endl;
@@ -74,10 +531,49 @@ int main( )
     for( int i = 0; i < N; ++i )
         b[ i ] = i;
     permute( b );
-    SORT( b );
+    simpleRecursiveSort( b );
     for( int i = 0; i < N; ++i )
         if( b[ i ] != i )
             cout << "OOPS!!" << endl;
+
+    cout << "Checking SORT on adversarial inputs" << endl;
+    checkAdversarial( N );
+
+    cout << "Checking selection" << endl;
+    checkSelection( N );
+
+    cout << "Checking sorting networks" << endl;
+    checkPrimitiveSorts<int>( "int" );
+    checkPrimitiveSorts<long long>( "long long" );
+    checkPrimitiveSorts<float>( "float" );
+    checkPrimitiveSorts<double>( "double" );
+    checkSignedZeros<float>( "float" );
+    checkSignedZeros<double>( "double" );
+
+    cout << "Checking radixSort" << endl;
+    checkRadixSort( N );
+
+    cout << "Checking index sorts" << endl;
+    checkIndexSorts( N );
+
+    cout << "Checking stable sorts" << endl;
+    checkStableSorts( );
+
+    cout << "Checking parallel sorts" << endl;
+    for( int numThreads = 1; numThreads <= 8; numThreads *= 2 )
+    {
+        permute( b );
+        parallelQuicksort( b, numThreads );
+        for( int i = 0; i < N; ++i )
+            if( b[ i ] != i )
+                cout << "OOPS!!" << endl;
+
+        permute( b );
+        parallelMergeSort( b, numThreads );
+        for( int i = 0; i < N; ++i )
+            if( b[ i ] != i )
+                cout << "OOPS!!" << endl;
+    }
     
     return 0;
 }
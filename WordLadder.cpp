@@ -1,11 +1,21 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <map>
 #include <queue>
 #include <algorithm>
 #include <ctime>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include "RunOnThreads.h"
+#include "MappedFile.h"
 using namespace std;
 
 /*
@@ -288,13 +298,1064 @@ vector<string> findChain( const vector<string> & words,
     return findChain( adjacentWords, first, second );
 }
 
-int main( )
+// A compact word graph: the words are interned in one arena of
+// characters and named by integer IDs (their rank in sorted order),
+// and the adjacency is in compressed sparse row form, so the
+// neighbors of word v are adj[ offsets[ v ] .. offsets[ v + 1 ] - 1 ].
+// There is one copy of each word and 4 bytes per directed edge,
+// against a string per edge and a tree node per word in
+// map<string,vector<string>>.
+// The arrays are reached through pointers, which point either into
+// the graph's own vectors or into memory that the caller owns.
+class WordGraph
+{
+  public:
+    // Build the graph of the distinct words in words, using numThreads
+    // threads; two words are adjacent if they have the same length
+    // and differ in one character
+    explicit WordGraph( const vector<string> & words,
+                        int numThreads = thread::hardware_concurrency( ) )
+    {
+        vector<string> sorted = words;
+        sort( begin( sorted ), end( sorted ) );
+        sorted.erase( unique( begin( sorted ), end( sorted ) ), end( sorted ) );
+
+        ownedWordStart.push_back( 0 );
+        for( auto & str : sorted )
+        {
+            ownedChars.insert( end( ownedChars ), begin( str ), end( str ) );
+            ownedWordStart.push_back( ownedChars.size( ) );
+        }
+        n = sorted.size( );
+        chars = ownedChars.data( );
+        wordStart = ownedWordStart.data( );
+
+        numThreads = max( numThreads, 1 );
+        makeCsr( findEdges( numThreads ), numThreads );
+    }
+
+    // A graph over arrays that the caller keeps alive
+    WordGraph( uint32_t numWords, const char *arena, const uint32_t *starts,
+               const uint32_t *csrOffsets, const uint32_t *csrAdj )
+      : n{ numWords }, chars{ arena }, wordStart{ starts },
+        offsets{ csrOffsets }, adj{ csrAdj }
+    {
+    }
+
+    WordGraph( const WordGraph & rhs ) = delete;
+    WordGraph & operator= ( const WordGraph & rhs ) = delete;
+    WordGraph( WordGraph && rhs ) = default;
+
+    int numWords( ) const
+      { return n; }
+    long long numEdges( ) const
+      { return offsets[ n ] / 2; }
+
+    string word( uint32_t v ) const
+      { return string( chars + wordStart[ v ], wordLength( v ) ); }
+    int wordLength( uint32_t v ) const
+      { return wordStart[ v + 1 ] - wordStart[ v ]; }
+
+    // The ID of str, or -1 if it is not a word
+    int id( const string & str ) const
+    {
+        uint32_t low = 0, high = n;
+        while( low < high )
+        {
+            uint32_t mid = low + ( high - low ) / 2;
+            if( compare( mid, str ) < 0 )
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low < n && compare( low, str ) == 0 ? low : -1;
+    }
+
+    int degree( uint32_t v ) const
+      { return offsets[ v + 1 ] - offsets[ v ]; }
+    const uint32_t * neighbors( uint32_t v ) const
+      { return adj + offsets[ v ]; }
+
+    // The arrays, for saving the graph
+    const char * arena( ) const
+      { return chars; }
+    const uint32_t * wordStarts( ) const
+      { return wordStart; }
+    const uint32_t * csrOffsets( ) const
+      { return offsets; }
+    const uint32_t * csrAdjacency( ) const
+      { return adj; }
+
+    long long sizeInBytes( ) const
+      { return wordStart[ n ] + ( 2 * ( n + 1LL ) + offsets[ n ] ) * sizeof( uint32_t ); }
+
+  private:
+    uint32_t n;
+    const char *chars;              // The words, back to back
+    const uint32_t *wordStart;      // Word v is chars[ wordStart[ v ] .. wordStart[ v + 1 ] - 1 ]
+    const uint32_t *offsets;
+    const uint32_t *adj;
+    vector<char> ownedChars;
+    vector<uint32_t> ownedWordStart;
+    vector<uint32_t> ownedOffsets;
+    vector<uint32_t> ownedAdj;
+
+    int compare( uint32_t v, const string & str ) const
+    {
+        int len = wordLength( v );
+        int cmp = str.compare( 0, string::npos, chars + wordStart[ v ], len );
+        return -cmp;
+    }
+
+    // Hash of word v with the character at position skip left out
+    uint64_t maskedHash( uint32_t v, int skip ) const
+    {
+        const char *w = chars + wordStart[ v ];
+        uint64_t h = 14695981039346656037ULL;
+        for( int k = 0; k < wordLength( v ); ++k )
+            if( k != skip )
+                h = ( h ^ static_cast<unsigned char>( w[ k ] ) ) * 1099511628211ULL;
+        return h;
+    }
+
+    // True if words v and w, of the same length, agree everywhere but at skip
+    bool sameExcept( uint32_t v, uint32_t w, int skip ) const
+    {
+        const char *a = chars + wordStart[ v ], *b = chars + wordStart[ w ];
+        return memcmp( a, b, skip ) == 0
+            && memcmp( a + skip + 1, b + skip + 1, wordLength( v ) - skip - 1 ) == 0;
+    }
+
+    // The edges ( v, w ), v < w, found as in computeAdjacentWords: words
+    // of the same length that agree once the character at some position
+    // is left out are adjacent. Each ( length, position ) group is a task;
+    // threads take the tasks, largest first, from a shared counter. A
+    // task sorts the group's words by masked hash, so equal representatives
+    // are next to each other, and no strings are built. Two words that
+    // differ in one character meet in exactly one group, so each edge is
+    // found once. Returns the edges found by each thread.
+    vector<vector<pair<uint32_t,uint32_t>>> findEdges( int numThreads ) const
+    {
+        vector<vector<uint32_t>> wordsByLength;
+        for( uint32_t v = 0; v < n; ++v )
+        {
+            if( wordLength( v ) >= wordsByLength.size( ) )
+                wordsByLength.resize( wordLength( v ) + 1 );
+            wordsByLength[ wordLength( v ) ].push_back( v );
+        }
+
+        vector<pair<int,int>> tasks;
+        for( int len = 1; len < wordsByLength.size( ); ++len )
+            for( int i = 0; i < len && wordsByLength[ len ].size( ) > 1; ++i )
+                tasks.push_back( { len, i } );
+        sort( begin( tasks ), end( tasks ), [ & ] ( const pair<int,int> & a, const pair<int,int> & b )
+              { return wordsByLength[ a.first ].size( ) > wordsByLength[ b.first ].size( ); } );
+
+        vector<vector<pair<uint32_t,uint32_t>>> edges( numThreads );
+        atomic<int> nextTask{ 0 };
+
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            vector<pair<uint64_t,uint32_t>> keys;
+
+            for( int task; ( task = nextTask++ ) < tasks.size( ); )
+            {
+                const vector<uint32_t> & groupsWords = wordsByLength[ tasks[ task ].first ];
+                int skip = tasks[ task ].second;
+
+                keys.clear( );
+                for( uint32_t v : groupsWords )
+                    keys.push_back( { maskedHash( v, skip ), v } );
+                sort( begin( keys ), end( keys ) );
+
+                for( int p = 0, q; p < keys.size( ); p = q )
+                {
+                    for( q = p + 1; q < keys.size( ) && keys[ q ].first == keys[ p ].first; ++q )
+                        ;
+                    for( int a = p; a < q; ++a )
+                        for( int b = a + 1; b < q; ++b )
+                            if( sameExcept( keys[ a ].second, keys[ b ].second, skip ) )
+                                edges[ t ].push_back( { keys[ a ].second, keys[ b ].second } );
+                }
+            }
+        } );
+
+        return edges;
+    }
+
+    // Fill the CSR arrays from each thread's edges, each stored in both
+    // directions, without locks: every thread counts the degrees of its
+    // own edges, the counts give each ( thread, word ) pair its own slots
+    // in adj, and the threads then scatter their edges into their slots.
+    // Each word's neighbors are left in increasing order.
+    void makeCsr( const vector<vector<pair<uint32_t,uint32_t>>> & edges, int numThreads )
+    {
+        vector<vector<uint32_t>> slot( numThreads, vector<uint32_t>( n ) );
+
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            for( auto & e : edges[ t ] )
+            {
+                ++slot[ t ][ e.first ];
+                ++slot[ t ][ e.second ];
+            }
+        } );
+
+        ownedOffsets.assign( n + 1, 0 );
+        for( uint32_t v = 0; v < n; ++v )
+        {
+            ownedOffsets[ v + 1 ] = ownedOffsets[ v ];
+            for( int t = 0; t < numThreads; ++t )
+                ownedOffsets[ v + 1 ] += slot[ t ][ v ];
+        }
+
+            // Turn the counts into each thread's next slot for each word
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            for( uint32_t v = sliceBegin( n, t, numThreads ); v < sliceBegin( n, t + 1, numThreads ); ++v )
+            {
+                uint32_t next = ownedOffsets[ v ];
+                for( int u = 0; u < numThreads; ++u )
+                {
+                    uint32_t count = slot[ u ][ v ];
+                    slot[ u ][ v ] = next;
+                    next += count;
+                }
+            }
+        } );
+
+        ownedAdj.resize( ownedOffsets[ n ] );
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            for( auto & e : edges[ t ] )
+            {
+                ownedAdj[ slot[ t ][ e.first ]++ ] = e.second;
+                ownedAdj[ slot[ t ][ e.second ]++ ] = e.first;
+            }
+        } );
+
+        runOnThreads( numThreads, [ & ] ( int t )
+        {
+            for( uint32_t v = sliceBegin( n, t, numThreads ); v < sliceBegin( n, t + 1, numThreads ); ++v )
+                sort( begin( ownedAdj ) + ownedOffsets[ v ], begin( ownedAdj ) + ownedOffsets[ v + 1 ] );
+        } );
+
+        offsets = ownedOffsets.data( );
+        adj = ownedAdj.data( );
+    }
+};
+
+// A WordGraph saved to disk and opened with mmap (see MappedFile.h):
+// the graph's arrays are used in place, so opening costs a few system
+// calls and one pass over the offsets and adjacency, rather than
+// reading the dictionary and finding the edges.
+// Layout (native byte order): a header, then wordStart ( n + 1 words ),
+// offsets ( n + 1 ), adj ( numAdj ), and the arena ( arenaBytes ), each
+// starting on a 64-byte boundary. Opening checks the header, that the
+// file is long enough, and that the arrays are well formed (offsets
+// that never decrease, and neighbors that are words), so that a
+// damaged file cannot send a search out of bounds; verify also checks
+// a checksum of the arrays, which catches any other damage.
+class WordGraphFile
+{
+  public:
+    explicit WordGraphFile( const string & fileName )
+      : file{ fileName }, header{ readHeader( file, fileName ) },
+        g{ header.numWords, reinterpret_cast<const char *>( file.data( ) ) + header.sectionStart[ ARENA ],
+           array( WORD_START ), array( OFFSETS ), array( ADJ ) }
+    {
+        if( !wellFormed( ) )
+            throw invalid_argument{ fileName + " is corrupt" };
+    }
+
+    // Write graph to fileName
+    static void write( const WordGraph & graph, const string & fileName )
+    {
+        uint32_t n = graph.numWords( );
+        Header h = makeHeader( n, graph.wordStarts( )[ n ], graph.csrOffsets( )[ n ] );
+        const char *sections[ NUM_SECTIONS ] = {
+            reinterpret_cast<const char *>( graph.wordStarts( ) ),
+            reinterpret_cast<const char *>( graph.csrOffsets( ) ),
+            reinterpret_cast<const char *>( graph.csrAdjacency( ) ),
+            graph.arena( ) };
+
+        for( int s = 0; s < NUM_SECTIONS; ++s )
+            h.checksum = checksum( sections[ s ], h.sectionBytes[ s ], h.checksum );
+
+        writeFileAtomically( fileName, [ & ] ( ofstream & out )
+        {
+            out.write( reinterpret_cast<const char *>( &h ), sizeof( h ) );
+            uint64_t written = sizeof( h );
+            for( int s = 0; s < NUM_SECTIONS; ++s )
+            {
+                static const char zeros[ ALIGNMENT ] = { };
+                out.write( zeros, h.sectionStart[ s ] - written );
+                out.write( sections[ s ], h.sectionBytes[ s ] );
+                written = h.sectionStart[ s ] + h.sectionBytes[ s ];
+            }
+        } );
+    }
+
+    const WordGraph & graph( ) const
+      { return g; }
+
+    // True if the arrays match the checksum they were saved with
+    bool verify( ) const
+    {
+        uint64_t sum = 0;
+        for( int s = 0; s < NUM_SECTIONS; ++s )
+            sum = checksum( file.data( ) + header.sectionStart[ s ], header.sectionBytes[ s ], sum );
+        return sum == header.checksum;
+    }
+
+  private:
+    enum Section { WORD_START, OFFSETS, ADJ, ARENA, NUM_SECTIONS };
+
+    struct Header
+    {
+        char magic[ 8 ];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t numWords;
+        uint32_t reserved;
+        uint64_t arenaBytes;
+        uint64_t numAdj;                        // Entries of adj: twice the edges
+        uint64_t sectionStart[ NUM_SECTIONS ];
+        uint64_t sectionBytes[ NUM_SECTIONS ];
+        uint64_t checksum;                      // Of the sections, in order
+    };
+
+    static constexpr const char *MAGIC = "WORDGRPH";
+    static const uint32_t VERSION = 1;
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static const int ALIGNMENT = 64;
+
+    MappedFile file;
+    Header header;
+    WordGraph g;
+
+    const uint32_t * array( Section s ) const
+      { return reinterpret_cast<const uint32_t *>( file.data( ) + header.sectionStart[ s ] ); }
+
+    // True if both offset arrays start at 0, never decrease, and end at
+    // the size of what they index, and every neighbor is a word
+    bool wellFormed( ) const
+    {
+        uint32_t n = header.numWords;
+        const uint32_t *starts = g.wordStarts( ), *offsets = g.csrOffsets( ), *adj = g.csrAdjacency( );
+
+        if( starts[ 0 ] != 0 || offsets[ 0 ] != 0
+            || starts[ n ] != header.arenaBytes || offsets[ n ] != header.numAdj )
+            return false;
+        for( uint32_t v = 0; v < n; ++v )
+            if( starts[ v + 1 ] < starts[ v ] || offsets[ v + 1 ] < offsets[ v ] )
+                return false;
+        for( uint64_t k = 0; k < header.numAdj; ++k )
+            if( adj[ k ] >= n )
+                return false;
+        return true;
+    }
+
+    static Header makeHeader( uint32_t n, uint64_t arenaBytes, uint64_t numAdj )
+    {
+        Header h{ };
+        memcpy( h.magic, MAGIC, sizeof( h.magic ) );
+        h.version = VERSION;
+        h.byteOrder = BYTE_ORDER_MARK;
+        h.numWords = n;
+        h.arenaBytes = arenaBytes;
+        h.numAdj = numAdj;
+        h.sectionBytes[ WORD_START ] = ( n + 1ULL ) * sizeof( uint32_t );
+        h.sectionBytes[ OFFSETS ] = ( n + 1ULL ) * sizeof( uint32_t );
+        h.sectionBytes[ ADJ ] = numAdj * sizeof( uint32_t );
+        h.sectionBytes[ ARENA ] = arenaBytes;
+
+        uint64_t at = sizeof( Header );
+        for( int s = 0; s < NUM_SECTIONS; ++s )
+        {
+            at = ( at + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT;
+            h.sectionStart[ s ] = at;
+            at += h.sectionBytes[ s ];
+        }
+        return h;
+    }
+
+    static Header readHeader( const MappedFile & file, const string & fileName )
+    {
+        Header h;
+        uint64_t fileBytes = file.size( );
+        if( fileBytes < sizeof( h ) )
+            throw invalid_argument{ fileName + " is not a word graph" };
+        memcpy( &h, file.data( ), sizeof( h ) );
+
+        if( memcmp( h.magic, MAGIC, sizeof( h.magic ) ) != 0 )
+            throw invalid_argument{ fileName + " is not a word graph" };
+        if( h.byteOrder != BYTE_ORDER_MARK )
+            throw invalid_argument{ fileName + " was written with another byte order" };
+        if( h.version != VERSION )
+            throw invalid_argument{ fileName + " has unsupported version " + to_string( h.version ) };
+
+            // The layout follows from the counts; anything else is corrupt
+        Header expected = makeHeader( h.numWords, h.arenaBytes, h.numAdj );
+        if( memcmp( h.sectionStart, expected.sectionStart, sizeof( h.sectionStart ) ) != 0
+            || memcmp( h.sectionBytes, expected.sectionBytes, sizeof( h.sectionBytes ) ) != 0 )
+            throw invalid_argument{ fileName + " is corrupt" };
+        if( h.sectionStart[ ARENA ] + h.sectionBytes[ ARENA ] > fileBytes )
+            throw invalid_argument{ fileName + " is truncated" };
+        return h;
+    }
+};
+
+// Runs a breadth-first search over word IDs, returning the sequence of
+// word changes to get from first to second; empty if either is not a
+// word or there is no such sequence.
+vector<string> findChain( const WordGraph & graph, const string & first,
+                          const string & second )
+{
+    int source = graph.id( first ), target = graph.id( second );
+    if( source < 0 || target < 0 )
+        return { };
+
+    vector<int> previous( graph.numWords( ), -1 );
+    vector<uint32_t> q;
+    previous[ source ] = source;
+    q.push_back( source );
+
+    for( int head = 0; head < q.size( ) && previous[ target ] < 0; ++head )
+    {
+        uint32_t current = q[ head ];
+        const uint32_t *adj = graph.neighbors( current );
+        for( int k = 0; k < graph.degree( current ); ++k )
+            if( previous[ adj[ k ] ] < 0 )
+            {
+                previous[ adj[ k ] ] = current;
+                q.push_back( adj[ k ] );
+            }
+    }
+
+    vector<string> result;
+    if( previous[ target ] < 0 )
+        return result;
+    for( int v = target; v != source; v = previous[ v ] )
+        result.push_back( graph.word( v ) );
+    result.push_back( graph.word( source ) );
+
+    reverse( begin( result ), end( result ) );
+    return result;
+}
+
+// Finds shortest chains in a WordGraph by bidirectional breadth-first
+// search: a level is taken alternately from whichever side has the
+// smaller frontier, until the two searches meet. The scratch arrays
+// are kept from one query to the next; instead of clearing them, each
+// query takes two new epochs, one per side, and a word has been seen
+// by a side only if its stamp holds that side's epoch. A ChainFinder
+// is used by one thread at a time; give each thread its own.
+class ChainFinder
+{
+  public:
+    explicit ChainFinder( const WordGraph & g )
+      : graph( g ), stamp( g.numWords( ), 0 ), dist( g.numWords( ) ),
+        link( g.numWords( ) ), epoch{ 0 }
+    {
+    }
+
+    // The IDs of a shortest chain from source to target; empty if there is none
+    vector<uint32_t> findChain( uint32_t source, uint32_t target )
+    {
+        if( epoch >= UINT32_MAX - 2 )
+        {
+            fill( begin( stamp ), end( stamp ), 0 );
+            epoch = 0;
+        }
+        uint32_t side[ 2 ] = { epoch += 2, epoch + 1 };     // From source, from target
+
+        if( source == target )
+            return { source };
+
+        frontier[ 0 ].assign( 1, source );
+        frontier[ 1 ].assign( 1, target );
+        for( int s = 0; s < 2; ++s )
+        {
+            uint32_t v = frontier[ s ][ 0 ];
+            stamp[ v ] = side[ s ];
+            dist[ v ] = 0;
+            link[ v ] = v;
+        }
+
+        while( !frontier[ 0 ].empty( ) && !frontier[ 1 ].empty( ) )
+        {
+            int s = frontier[ 0 ].size( ) <= frontier[ 1 ].size( ) ? 0 : 1;
+            next.clear( );
+
+                // Expand a whole level, keeping the best meeting: a word
+                // seen by the other side at a smaller depth may come later
+            int best = -1;
+            pair<uint32_t,uint32_t> meet;
+            for( uint32_t u : frontier[ s ] )
+            {
+                const uint32_t *adj = graph.neighbors( u );
+                for( int k = 0; k < graph.degree( u ); ++k )
+                {
+                    uint32_t w = adj[ k ];
+                    if( stamp[ w ] == side[ 1 - s ] )
+                    {
+                        if( best < 0 || dist[ u ] + 1 + dist[ w ] < best )
+                        {
+                            best = dist[ u ] + 1 + dist[ w ];
+                            meet = { u, w };
+                        }
+                    }
+                    else if( stamp[ w ] != side[ s ] )
+                    {
+                        stamp[ w ] = side[ s ];
+                        dist[ w ] = dist[ u ] + 1;
+                        link[ w ] = u;
+                        next.push_back( w );
+                    }
+                }
+            }
+
+            if( best >= 0 )
+                return makeChain( s == 0 ? meet.first : meet.second,
+                                  s == 0 ? meet.second : meet.first );
+            frontier[ s ].swap( next );
+        }
+
+        return { };
+    }
+
+  private:
+    const WordGraph & graph;
+    vector<uint32_t> stamp;         // Epoch of the side that has seen each word
+    vector<int> dist;               // Distance from that side's end
+    vector<uint32_t> link;          // Previous word on the way to that side's end
+    uint32_t epoch;
+    vector<uint32_t> frontier[ 2 ];
+    vector<uint32_t> next;
+
+    // The chain through the edge ( a, b ), a seen from the source
+    // and b from the target
+    vector<uint32_t> makeChain( uint32_t a, uint32_t b ) const
+    {
+        vector<uint32_t> chain;
+        for( ; link[ a ] != a; a = link[ a ] )
+            chain.push_back( a );
+        chain.push_back( a );
+        reverse( begin( chain ), end( chain ) );
+
+        for( ; link[ b ] != b; b = link[ b ] )
+            chain.push_back( b );
+        chain.push_back( b );
+        return chain;
+    }
+};
+
+// Answers word pairs, one pair per line of in, printing each chain on
+// its own line of cout, in input order (an empty line if there is no
+// chain, or if the line is not two words). The queries are shared out
+// among numThreads threads, each with its own ChainFinder; the rate is
+// reported on cerr.
+void batchQueries( const WordGraph & graph, istream & in, int numThreads )
+{
+    vector<pair<int,int>> queries;
+    for( string line; getline( in, line ); )
+    {
+        istringstream words( line );
+        string w1, w2, extra;
+        if( words >> w1 >> w2 && !( words >> extra ) )
+            queries.push_back( { graph.id( w1 ), graph.id( w2 ) } );
+        else
+            queries.push_back( { -1, -1 } );
+    }
+
+    vector<vector<uint32_t>> chains( queries.size( ) );
+    atomic<int> nextQuery{ 0 };
+    const int BATCH = 64;
+
+    auto start = chrono::steady_clock::now( );
+    runOnThreads( numThreads, [ & ] ( int )
+    {
+        ChainFinder finder{ graph };
+        for( int first; ( first = nextQuery.fetch_add( BATCH ) ) < queries.size( ); )
+            for( int q = first; q < queries.size( ) && q < first + BATCH; ++q )
+                if( queries[ q ].first >= 0 && queries[ q ].second >= 0 )
+                    chains[ q ] = finder.findChain( queries[ q ].first, queries[ q ].second );
+    } );
+    double seconds = chrono::duration<double>( chrono::steady_clock::now( ) - start ).count( );
+
+    for( auto & chain : chains )
+    {
+        for( int i = 0; i < chain.size( ); ++i )
+            cout << ( i == 0 ? "" : " " ) << graph.word( chain[ i ] );
+        cout << '\n';
+    }
+
+    cerr << queries.size( ) << " queries on " << numThreads << " threads in "
+         << seconds << " s: " << queries.size( ) / max( seconds, 1e-9 ) << " queries/s" << endl;
+}
+
+// The statistics of the words of one length
+struct LengthStats
+{
+    int length = 0;
+    int words = 0;
+    int components = 0;             // Counting words with no neighbors
+    int largestComponent = 0;
+    int diameter = 0;               // Largest eccentricity
+    uint32_t diameterSource = 0;    // A word with that eccentricity
+    uint32_t diameterTarget = 0;    // A word that far from diameterSource
+};
+
+// The statistics of every length, and the distances over all pairs
+struct GraphStats
+{
+    vector<LengthStats> byLength;
+    vector<long long> ladderLengths;    // Unordered pairs at each distance
+    vector<int> eccentricity;           // By word ID; 0 for a word with no neighbors
+};
+
+// Graph-wide statistics of a WordGraph, from a breadth-first search
+// out of every word. Words are only adjacent to words of the same
+// length, so each length class is done on its own, with its words
+// renumbered 0..m-1 in component order and its edges copied into a
+// local CSR that fits in cache.
+// The searches are bit-parallel (multi-source BFS): WORDS * 64 sources
+// run at once, and every word holds one bit per source in seen, in
+// the current frontier, and in the next one. A level is one pass over
+// the frontier, ORing each word's frontier bits into its neighbors,
+// so a whole batch of searches costs about as much as one.
+template <int WORDS>
+GraphStats analyzeGraph( const WordGraph & graph )
+{
+    const int SOURCES = 64 * WORDS;
+    GraphStats stats;
+    stats.eccentricity.assign( graph.numWords( ), 0 );
+
+    vector<vector<uint32_t>> wordsByLength;
+    for( int v = 0; v < graph.numWords( ); ++v )
+    {
+        if( graph.wordLength( v ) >= wordsByLength.size( ) )
+            wordsByLength.resize( graph.wordLength( v ) + 1 );
+        wordsByLength[ graph.wordLength( v ) ].push_back( v );
+    }
+
+    vector<int> local( graph.numWords( ), -1 );
+    for( int len = 1; len < wordsByLength.size( ); ++len )
+    {
+        const vector<uint32_t> & group = wordsByLength[ len ];
+        if( group.empty( ) )
+            continue;
+        LengthStats ls;
+        ls.length = len;
+        ls.words = group.size( );
+
+            // Number the words component by component, with a plain BFS
+        vector<uint32_t> order;
+        vector<int> componentBegin, componentEnd;     // Of each local word's component
+        for( uint32_t start : group )
+            if( local[ start ] < 0 )
+            {
+                int first = order.size( );
+                local[ start ] = first;
+                order.push_back( start );
+                for( int head = first; head < order.size( ); ++head )
+                {
+                    const uint32_t *adj = graph.neighbors( order[ head ] );
+                    for( int k = 0; k < graph.degree( order[ head ] ); ++k )
+                        if( local[ adj[ k ] ] < 0 )
+                        {
+                            local[ adj[ k ] ] = order.size( );
+                            order.push_back( adj[ k ] );
+                        }
+                }
+                ++ls.components;
+                ls.largestComponent = max<int>( ls.largestComponent, order.size( ) - first );
+                componentBegin.resize( order.size( ), first );
+                componentEnd.resize( order.size( ), order.size( ) );
+            }
+
+        int m = order.size( );
+        vector<uint32_t> offsets( m + 1, 0 ), adj;
+        for( int i = 0; i < m; ++i )
+        {
+            const uint32_t *neighbors = graph.neighbors( order[ i ] );
+            for( int k = 0; k < graph.degree( order[ i ] ); ++k )
+                adj.push_back( local[ neighbors[ k ] ] );
+            offsets[ i + 1 ] = adj.size( );
+        }
+
+            // A batch of sources can only reach words in their own
+            // components, which are words low..high-1
+        vector<uint64_t> seen( m * WORDS ), frontier( m * WORDS ), next( m * WORDS );
+        for( int base = 0; base < m; base += SOURCES )
+        {
+            int numSources = min( SOURCES, m - base );
+            int low = componentBegin[ base ], high = componentEnd[ base + numSources - 1 ];
+            fill( begin( seen ) + low * WORDS, begin( seen ) + high * WORDS, 0 );
+            fill( begin( frontier ) + low * WORDS, begin( frontier ) + high * WORDS, 0 );
+            for( int s = 0; s < numSources; ++s )
+            {
+                seen[ ( base + s ) * WORDS + s / 64 ] |= uint64_t( 1 ) << ( s % 64 );
+                frontier[ ( base + s ) * WORDS + s / 64 ] |= uint64_t( 1 ) << ( s % 64 );
+            }
+
+            for( int level = 1; ; ++level )
+            {
+                fill( begin( next ) + low * WORDS, begin( next ) + high * WORDS, 0 );
+                for( int i = low; i < high; ++i )
+                {
+                    const uint64_t *f = &frontier[ i * WORDS ];
+                    uint64_t any = 0;
+                    for( int w = 0; w < WORDS; ++w )
+                        any |= f[ w ];
+                    if( any == 0 )
+                        continue;
+                    for( uint32_t k = offsets[ i ]; k < offsets[ i + 1 ]; ++k )
+                        for( int w = 0; w < WORDS; ++w )
+                            next[ adj[ k ] * WORDS + w ] |= f[ w ];
+                }
+
+                    // Keep only the new bits; note the sources still reaching words
+                uint64_t active[ WORDS ] = { };
+                long long reached = 0;
+                for( int i = low * WORDS; i < high * WORDS; ++i )
+                {
+                    next[ i ] &= ~seen[ i ];
+                    seen[ i ] |= next[ i ];
+                    active[ i % WORDS ] |= next[ i ];
+                    reached += __builtin_popcountll( next[ i ] );
+                }
+                if( reached == 0 )
+                    break;
+
+                if( level >= stats.ladderLengths.size( ) )
+                    stats.ladderLengths.resize( level + 1 );
+                stats.ladderLengths[ level ] += reached;
+                for( int w = 0; w < WORDS; ++w )
+                    for( uint64_t bits = active[ w ]; bits != 0; bits &= bits - 1 )
+                        stats.eccentricity[ order[ base + w * 64 + __builtin_ctzll( bits ) ] ] = level;
+                frontier.swap( next );
+            }
+        }
+
+        for( uint32_t v : group )
+            if( stats.eccentricity[ v ] > ls.diameter || ( ls.diameter == 0 && v == group[ 0 ] ) )
+            {
+                ls.diameter = stats.eccentricity[ v ];
+                ls.diameterSource = v;
+            }
+
+            // The last word a plain BFS from diameterSource reaches
+        vector<int> bfs{ local[ ls.diameterSource ] };
+        vector<bool> reached( m, false );
+        reached[ bfs[ 0 ] ] = true;
+        for( int head = 0; head < bfs.size( ); ++head )
+            for( uint32_t k = offsets[ bfs[ head ] ]; k < offsets[ bfs[ head ] + 1 ]; ++k )
+                if( !reached[ adj[ k ] ] )
+                {
+                    reached[ adj[ k ] ] = true;
+                    bfs.push_back( adj[ k ] );
+                }
+        ls.diameterTarget = order[ bfs.back( ) ];
+        stats.byLength.push_back( ls );
+    }
+
+    for( long long & pairs : stats.ladderLengths )
+        pairs /= 2;
+    return stats;
+}
+
+// Prints the statistics of analyzeGraph for graph, with one longest
+// shortest ladder for each length.
+void printGraphStats( const WordGraph & graph )
+{
+    auto wallStart = chrono::steady_clock::now( );
+    GraphStats stats = analyzeGraph<4>( graph );
+    double seconds = chrono::duration<double>( chrono::steady_clock::now( ) - wallStart ).count( );
+
+    long long pairs = 0;
+    for( long long p : stats.ladderLengths )
+        pairs += p;
+    cout << "Searched from all " << graph.numWords( ) << " words in " << seconds << " s; "
+         << pairs << " connected pairs" << endl;
+
+    cout << "length  words  components  largest  diameter" << endl;
+    for( const LengthStats & ls : stats.byLength )
+        printf( "%6d %6d %11d %8d %9d  %s -> %s\n", ls.length, ls.words, ls.components,
+                ls.largestComponent, ls.diameter, graph.word( ls.diameterSource ).c_str( ),
+                graph.word( ls.diameterTarget ).c_str( ) );
+
+    cout << "ladder length  pairs" << endl;
+    for( int d = 1; d < stats.ladderLengths.size( ); ++d )
+        printf( "%13d %6lld\n", d, stats.ladderLengths[ d ] );
+}
+
+// Roughly the bytes that an adjacency map takes: a tree node per key,
+// and a vector of strings per value, counting string heap buffers
+// (those too long for the short-string buffer) and spare capacity.
+long long mapSizeInBytes( const map<string,vector<string>> & adjacentWords )
+{
+    const long long NODE_OVERHEAD = 32;       // Color, parent, and children
+    const long long SHORT_STRING = 15;
+    long long bytes = 0;
+
+    for( auto & entry : adjacentWords )
+    {
+        bytes += NODE_OVERHEAD + sizeof( entry );
+        if( entry.first.capacity( ) > SHORT_STRING )
+            bytes += entry.first.capacity( ) + 1;
+        bytes += entry.second.capacity( ) * sizeof( string );
+        for( auto & str : entry.second )
+            if( str.capacity( ) > SHORT_STRING )
+                bytes += str.capacity( ) + 1;
+    }
+    return bytes;
+}
+
+// Builds the map and the WordGraph from the same words, compares their
+// time, space, and edges, times the WordGraph builder on 2, 4, ...
+// threads, and times findChain on both for numQueries random pairs
+// of words of the same length, checking that the chains have equal length;
+// then times analyzeGraph at 64 and 256 sources, checking it against plain BFS.
+void compareGraphs( const vector<string> & words, int numQueries )
+{
+    clock_t start = clock( );
+    map<string,vector<string>> adjacentWords = computeAdjacentWords( words );
+    double mapSeconds = double( clock( ) - start ) / CLOCKS_PER_SEC;
+
+    start = clock( );
+    WordGraph graph{ words, 1 };
+    double graphSeconds = double( clock( ) - start ) / CLOCKS_PER_SEC;
+
+    cout << graph.numWords( ) << " words, " << graph.numEdges( ) << " edges" << endl;
+    cout << "map:   built in " << mapSeconds << " s, about "
+         << mapSizeInBytes( adjacentWords ) / 1e6 << " MB" << endl;
+    cout << "graph: built in " << graphSeconds << " s, "
+         << graph.sizeInBytes( ) / 1e6 << " MB" << endl;
+
+    for( int numThreads = 2; numThreads <= 2 * thread::hardware_concurrency( ); numThreads *= 2 )
+    {
+        start = clock( );
+        auto wallStart = chrono::steady_clock::now( );
+        WordGraph parallelGraph{ words, numThreads };
+        cout << "graph: built in " << chrono::duration<double>( chrono::steady_clock::now( ) - wallStart ).count( )
+             << " s (" << double( clock( ) - start ) / CLOCKS_PER_SEC << " s cpu) on "
+             << numThreads << " threads" << endl;
+
+        uint32_t n = graph.numWords( );
+        if( parallelGraph.numWords( ) != n
+            || !equal( graph.csrOffsets( ), graph.csrOffsets( ) + n + 1, parallelGraph.csrOffsets( ) )
+            || !equal( graph.csrAdjacency( ), graph.csrAdjacency( ) + graph.csrOffsets( )[ n ],
+                       parallelGraph.csrAdjacency( ) ) )
+            cout << "OOPS!! the graph built on " << numThreads << " threads differs" << endl;
+    }
+
+    bool same = true;
+    for( int v = 0; v < graph.numWords( ); ++v )
+    {
+        auto itr = adjacentWords.find( graph.word( v ) );
+        vector<string> expected;
+        if( itr != adjacentWords.end( ) )
+            expected = itr->second;
+        vector<string> found;
+        for( int k = 0; k < graph.degree( v ); ++k )
+            found.push_back( graph.word( graph.neighbors( v )[ k ] ) );
+        sort( begin( expected ), end( expected ) );
+        same = same && found == expected;
+    }
+    if( !same )
+        cout << "OOPS!! graph and map have different edges" << endl;
+
+    vector<vector<string>> byLength( 32 );
+    for( int v = 0; v < graph.numWords( ); ++v )
+        if( graph.wordLength( v ) < byLength.size( ) && graph.degree( v ) > 0 )
+            byLength[ graph.wordLength( v ) ].push_back( graph.word( v ) );
+
+    vector<pair<string,string>> queries;
+    srand( 1 );
+    while( queries.size( ) < numQueries )
+    {
+        vector<string> & group = byLength[ 3 + rand( ) % 6 ];
+        queries.push_back( { group[ rand( ) % group.size( ) ], group[ rand( ) % group.size( ) ] } );
+    }
+
+    vector<int> mapLengths, graphLengths;
+    start = clock( );
+    for( auto & query : queries )
+    {
+        vector<string> path = findChain( adjacentWords, query.first, query.second );
+        mapLengths.push_back( path.size( ) > 1 || query.first == query.second ? path.size( ) : 0 );
+    }
+    double mapQuerySeconds = double( clock( ) - start ) / CLOCKS_PER_SEC;
+
+    start = clock( );
+    for( auto & query : queries )
+        graphLengths.push_back( findChain( graph, query.first, query.second ).size( ) );
+    double graphQuerySeconds = double( clock( ) - start ) / CLOCKS_PER_SEC;
+
+    vector<int> bidirectionalLengths;
+    ChainFinder finder{ graph };
+    start = clock( );
+    for( auto & query : queries )
+    {
+        vector<uint32_t> chain = finder.findChain( graph.id( query.first ), graph.id( query.second ) );
+        bidirectionalLengths.push_back( chain.size( ) );
+        for( int i = 0; i + 1 < chain.size( ); ++i )
+        {
+            const uint32_t *adj = graph.neighbors( chain[ i ] );
+            if( !binary_search( adj, adj + graph.degree( chain[ i ] ), chain[ i + 1 ] ) )
+                cout << "OOPS!! broken chain" << endl;
+        }
+    }
+    double bidirectionalSeconds = double( clock( ) - start ) / CLOCKS_PER_SEC;
+
+    cout << "findChain: map " << 1e3 * mapQuerySeconds / numQueries << " ms, graph "
+         << 1e3 * graphQuerySeconds / numQueries << " ms, bidirectional "
+         << 1e3 * bidirectionalSeconds / numQueries << " ms per query"
+         << ( mapLengths == graphLengths && graphLengths == bidirectionalLengths
+                ? "" : "  OOPS!! chain lengths differ" ) << endl;
+
+    start = clock( );
+    GraphStats stats64 = analyzeGraph<1>( graph );
+    double seconds64 = double( clock( ) - start ) / CLOCKS_PER_SEC;
+    start = clock( );
+    GraphStats stats256 = analyzeGraph<4>( graph );
+    double seconds256 = double( clock( ) - start ) / CLOCKS_PER_SEC;
+    cout << "all-pairs BFS: " << seconds64 << " s at 64 sources, "
+         << seconds256 << " s at 256 sources" << endl;
+
+        // Check some eccentricities against plain BFS
+    start = clock( );
+    vector<int> dist( graph.numWords( ), -1 );
+    int searched = 0;
+    bool consistent = stats64.eccentricity == stats256.eccentricity
+                && stats64.ladderLengths == stats256.ladderLengths;
+    for( int source = 0; source < graph.numWords( ); source += 97 )
+    {
+        vector<uint32_t> q( 1, source );
+        dist[ source ] = 0;
+        for( int head = 0; head < q.size( ); ++head )
+            for( int k = 0; k < graph.degree( q[ head ] ); ++k )
+            {
+                uint32_t w = graph.neighbors( q[ head ] )[ k ];
+                if( dist[ w ] < 0 )
+                {
+                    dist[ w ] = dist[ q[ head ] ] + 1;
+                    q.push_back( w );
+                }
+            }
+        consistent = consistent && dist[ q.back( ) ] == stats64.eccentricity[ source ];
+        for( uint32_t v : q )
+            dist[ v ] = -1;
+        ++searched;
+    }
+    cout << "plain BFS from every word would take about "
+         << double( clock( ) - start ) / CLOCKS_PER_SEC * graph.numWords( ) / searched << " s"
+         << ( consistent ? "" : "  OOPS!! graph statistics differ" ) << endl;
+}
+
+// Usage: WordLadder                     (prints the most changeable
+//                                         words, then finds chains
+//                                         for pairs read from cin)
+//        WordLadder compare [numQueries]
+//              (time and space of the map and the WordGraph, the
+//               WordGraph builder on more threads, and findChain
+//               on both, default 1000 random pairs)
+//        WordLadder batch [pairFile [threads]]
+//              (a chain for each pair of words, one pair per line of
+//               pairFile, or of cin if it is - or missing; the
+//               queries/s go to cerr)
+//        WordLadder save indexFile
+//              (build the graph of dict.txt and save it to indexFile)
+//        WordLadder open indexFile [verify] [pairFile [threads]]
+//              (as batch, on the graph mapped from indexFile; the
+//               time to open it goes to cerr; with verify, first
+//               checks the checksum, and fails if it does not match)
+//        WordLadder stats
+//              (components, diameter, and a longest shortest ladder
+//               for each word length, and a histogram of the lengths
+//               of all shortest ladders)
+int main( int argc, char *argv[ ] )
 {
     clock_t start, end;
+    string mode = argc > 1 ? argv[ 1 ] : "";
+
+        // Answer the pairs in argv[ arg ], on argv[ arg + 1 ] threads;
+        // returns the exit status
+    auto runBatch = [ & ] ( const WordGraph & graph, int arg )
+    {
+        int numThreads = argc > arg + 1 ? atoi( argv[ arg + 1 ] ) : thread::hardware_concurrency( );
+        if( argc > arg && string( argv[ arg ] ) != "-" )
+        {
+            ifstream pairs( argv[ arg ] );
+            if( !pairs )
+            {
+                cerr << "Cannot open " << argv[ arg ] << endl;
+                return 1;
+            }
+            batchQueries( graph, pairs, max( numThreads, 1 ) );
+        }
+        else
+            batchQueries( graph, cin, max( numThreads, 1 ) );
+        return 0;
+    };
+
+    if( mode == "open" && argc > 2 )
+    {
+        try
+        {
+            auto wallStart = chrono::steady_clock::now( );
+            WordGraphFile saved{ argv[ 2 ] };
+            double seconds = chrono::duration<double>( chrono::steady_clock::now( ) - wallStart ).count( );
+            cerr << "Opened " << argv[ 2 ] << " in " << 1e3 * seconds << " ms" << endl;
+
+            bool verify = argc > 3 && string( argv[ 3 ] ) == "verify";
+            if( verify && !saved.verify( ) )
+            {
+                cerr << argv[ 2 ] << " does not match its checksum" << endl;
+                return 1;
+            }
+            return runBatch( saved.graph( ), verify ? 4 : 3 );
+        }
+        catch( const exception & e )
+        {
+            cerr << e.what( ) << endl;
+            return 1;
+        }
+    }
 
     ifstream fin( "dict.txt" );
     vector<string> words = readWords( fin );
+
+    if( mode == "batch" )
+    {
+        WordGraph graph{ words };
+        return runBatch( graph, 2 );
+    }
+    if( mode == "stats" )
+    {
+        WordGraph graph{ words };
+        printGraphStats( graph );
+        return 0;
+    }
+    if( mode == "save" && argc > 2 )
+    {
+        WordGraph graph{ words };
+        WordGraphFile::write( graph, argv[ 2 ] );
+        cout << "Saved " << graph.numWords( ) << " words and " << graph.numEdges( )
+             << " edges to " << argv[ 2 ] << endl;
+        return 0;
+    }
+
     cout << "Read the words..." << words.size( ) << endl;
+
+    if( mode == "compare" )
+    {
+        compareGraphs( words, argc > 2 ? atoi( argv[ 2 ] ) : 1000 );
+        return 0;
+    }
+
     map<string,vector<string> > adjacentWords;
     
     start = clock( );
@@ -304,6 +1365,11 @@ int main( )
 
     printHighChangeables( adjacentWords, 15 );
 
+    start = clock( );
+    WordGraph graph{ words };
+    end = clock( );
+    cout << "Elapsed time WordGraph: " << double(end-start)/CLOCKS_PER_SEC << endl;
+
     /*
     start = clock( );
     adjacentWords = computeAdjacentWordsMedium( words );
@@ -326,9 +1392,10 @@ int main( )
     {
         cout << "Enter two words: ";
         string w1, w2;
-        cin >> w1 >> w2;
+        if( !( cin >> w1 >> w2 ) )
+            break;
 
-        vector<string> path = findChain( adjacentWords, w1, w2 );
+        vector<string> path = findChain( graph, w1, w2 );
         cout << path.size( ) << endl;
         for( string & word : path )
             cout << word << " " ;
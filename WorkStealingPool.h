@@ -0,0 +1,195 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+// WorkStealingPool class
+//
+// CONSTRUCTION: with the total number of threads, counting the
+//     thread that constructs the pool (so 1 means no helpers).
+//
+// ******************PUBLIC OPERATIONS*********************
+// void submit( task, pending ) --> Queue task; --pending when it finishes
+// void waitUntilDone( pending ) --> Run or steal tasks until pending is 0
+// int numThreads( )            --> Return the number of threads
+// ******************ERRORS********************************
+// Tasks must not throw; an escaping exception terminates the program.
+//
+// Each thread owns a deque. It pushes and pops new work at the back
+// and, when idle, steals the oldest (largest) work from the front of
+// some other thread's deque. Waiting is always done by helping, so
+// tasks may submit subtasks and wait for them without deadlock.
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+using namespace std;
+
+class WorkStealingPool
+{
+  public:
+    explicit WorkStealingPool( int numThreads )
+      : queues( numThreads < 1 ? 1 : numThreads ), queued{ 0 }, done{ false }
+    {
+        for( int i = 1; i < queues.size( ); ++i )
+            workers.push_back( thread{ &WorkStealingPool::workerLoop, this, i } );
+    }
+
+    ~WorkStealingPool( )
+    {
+        {
+            lock_guard<mutex> lock{ sleepMutex };
+            done = true;
+        }
+        wakeUp.notify_all( );
+        for( thread & t : workers )
+            t.join( );
+    }
+
+    WorkStealingPool( const WorkStealingPool & ) = delete;
+    WorkStealingPool & operator= ( const WorkStealingPool & ) = delete;
+
+    int numThreads( ) const
+      { return queues.size( ); }
+
+    /**
+     * Queue task on the calling thread's deque.
+     * pending is decremented after task has run; the caller
+     * is responsible for having incremented it beforehand.
+     */
+    void submit( function<void( )> task, atomic<int> & pending )
+    {
+        WorkQueue & q = queues[ myIndex( ) ];
+        {
+            lock_guard<mutex> lock{ sleepMutex };
+            ++queued;     // Count first, so queued never undercounts
+        }
+        {
+            lock_guard<mutex> lock{ q.guard };
+            q.tasks.push_back( Task{ std::move( task ), &pending } );
+        }
+        wakeUp.notify_one( );
+    }
+
+    /**
+     * Execute queued tasks (our own first, then stolen ones)
+     * until pending drops to zero.
+     */
+    void waitUntilDone( const atomic<int> & pending )
+    {
+        int self = myIndex( );
+        while( pending.load( ) > 0 )
+            if( !runOneTask( self ) )
+                this_thread::yield( );
+    }
+
+  private:
+    struct Task
+    {
+        function<void( )> work;
+        atomic<int> *pending;
+    };
+
+    struct WorkQueue
+    {
+        mutex guard;
+        deque<Task> tasks;
+    };
+
+    vector<WorkQueue> queues;
+    vector<thread> workers;
+
+    mutex sleepMutex;
+    condition_variable wakeUp;
+    int queued;
+    bool done;
+
+    /**
+     * Index of the calling thread's deque. Threads that do not
+     * belong to this pool share deque 0 with the constructing thread.
+     */
+    int myIndex( ) const
+    {
+        return currentPool( ) == this ? currentIndex( ) : 0;
+    }
+
+    static const WorkStealingPool * & currentPool( )
+    {
+        static thread_local const WorkStealingPool *pool = nullptr;
+        return pool;
+    }
+
+    static int & currentIndex( )
+    {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    /**
+     * Take one task, from the back of deque self if possible,
+     * otherwise from the front of another deque, and run it.
+     * Return false if every deque was empty.
+     */
+    bool runOneTask( int self )
+    {
+        Task task;
+        bool found = popBack( self, task );
+
+        for( int i = 1; !found && i < queues.size( ); ++i )
+            found = popFront( ( self + i ) % queues.size( ), task );
+
+        if( !found )
+            return false;
+
+        {
+            lock_guard<mutex> lock{ sleepMutex };
+            --queued;
+        }
+        task.work( );
+        --*task.pending;
+        return true;
+    }
+
+    bool popBack( int idx, Task & task )
+    {
+        WorkQueue & q = queues[ idx ];
+        lock_guard<mutex> lock{ q.guard };
+        if( q.tasks.empty( ) )
+            return false;
+        task = std::move( q.tasks.back( ) );
+        q.tasks.pop_back( );
+        return true;
+    }
+
+    bool popFront( int idx, Task & task )
+    {
+        WorkQueue & q = queues[ idx ];
+        lock_guard<mutex> lock{ q.guard };
+        if( q.tasks.empty( ) )
+            return false;
+        task = std::move( q.tasks.front( ) );
+        q.tasks.pop_front( );
+        return true;
+    }
+
+    void workerLoop( int self )
+    {
+        currentPool( ) = this;
+        currentIndex( ) = self;
+
+        for( ; ; )
+        {
+            if( runOneTask( self ) )
+                continue;
+
+            unique_lock<mutex> lock{ sleepMutex };
+            wakeUp.wait( lock, [ this ] { return done || queued > 0; } );
+            if( done )
+                return;
+        }
+    }
+};
+
+#endif